@@ -0,0 +1,249 @@
+// Microbenchmarks for tessellation, model I/O, hierarchy update and headless frames.
+// Prints one JSON object per line so results can be diffed between builds:
+//
+//   {"name":"mesh/SPHERE/L4","iterations":256,"ns_per_op":...,"items_per_s":...,"mb_per_s":...}
+//
+// Usage: modeller_bench [--filter SUBSTRING] [--nodes N] [--min-time SECONDS]
+//        modeller_bench --check-hierarchy [--nodes N]     (see `make hierarchy-check`)
+
+#include <glm/glm.hpp>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+#include "../src/model.cpp"
+#include "../src/headless.cpp"
+#include "../src/model_generator.cpp"
+#include "../src/selection.cpp"
+
+// --- Harness ---
+
+struct BenchConfig {
+    std::string filter;
+    size_t nodes = 100000;
+    double minTime = 0.25;
+};
+
+static BenchConfig config;
+
+// Times fn() and reports it. `items` and `bytes` are per call, used for throughput.
+static void bench(const std::string &name, double items, double bytes, const std::function<void()> &fn) {
+    if (!config.filter.empty() && name.find(config.filter) == std::string::npos) return;
+    using clock = std::chrono::steady_clock;
+    fn(); // warm-up
+    size_t iterations = 1;
+    double seconds = 0.0;
+    while (true) {
+        auto start = clock::now();
+        for (size_t i = 0; i < iterations; i++) fn();
+        seconds = std::chrono::duration<double>(clock::now() - start).count();
+        if (seconds >= config.minTime || iterations >= (1u << 24)) break;
+        iterations *= seconds > 0.0 ? std::min<size_t>(16, (size_t)(config.minTime / seconds) + 1) : 16;
+    }
+    double perOp = seconds / iterations;
+    std::printf("{\"name\":\"%s\",\"iterations\":%zu,\"ns_per_op\":%.1f", name.c_str(), iterations, perOp * 1e9);
+    if (items > 0) std::printf(",\"items_per_s\":%.1f", items / perOp);
+    if (bytes > 0) std::printf(",\"mb_per_s\":%.2f", bytes / perOp / (1024.0 * 1024.0));
+    std::printf("}\n");
+    std::fflush(stdout);
+}
+
+static void skipped(const std::string &name, const std::string &why) {
+    if (!config.filter.empty() && name.find(config.filter) == std::string::npos) return;
+    std::printf("{\"name\":\"%s\",\"skipped\":\"%s\"}\n", name.c_str(), why.c_str());
+}
+
+static const ShapeType kTypes[] = {ShapeType::SPHERE_SHAPE, ShapeType::CYLINDER_SHAPE, ShapeType::BOX_SHAPE, ShapeType::CONE_SHAPE};
+static const char *kTypeNames[] = {"SPHERE", "CYLINDER", "BOX", "CONE"};
+
+// --- Benchmarks ---
+
+static void benchTessellation() {
+    for (int t = 0; t < 4; t++) {
+        for (unsigned int level = 1; level <= 4; level++) {
+            size_t tris = buildUnitMesh(kTypes[t], level).triangleCount();
+            std::string suffix = std::string(kTypeNames[t]) + "/L" + std::to_string(level);
+            bench("mesh/" + suffix, tris, 0, [&] { UnitMesh m = buildUnitMesh(kTypes[t], level); (void)m; });
+            bench("mesh_raw/" + suffix, tris, 0, [&] { UnitMesh m = buildUnitMesh(kTypes[t], level, false); (void)m; });
+        }
+    }
+}
+
+// Writes the benchmark model (config.nodes nodes, level 1); returns its size in bytes.
+// `depth` 2 puts every node but the root under one assembly node.
+static size_t writeBenchModel(const std::string &path, unsigned int depth = 12) {
+    GeneratorOptions gen;
+    gen.nodes = config.nodes;
+    gen.depth = depth;
+    gen.branching = depth == 2 ? (unsigned int)config.nodes : 8;
+    gen.minLevel = gen.maxLevel = 1;
+    std::ostringstream text;
+    std::string error;
+    ModelGenerator().generate(gen, text, error);
+    std::ofstream out(path);
+    out << text.str();
+    return text.str().size();
+}
+
+static void benchModelIO(const std::string &path) {
+    double bytes = (double)writeBenchModel(path);
+    double nodes = (double)config.nodes;
+
+    std::streambuf *coutBuf = std::cout.rdbuf(nullptr); // silence Model's status messages
+    Model model;
+    model.load(path);
+    bench("io/load", nodes, bytes, [&] { Model m; m.load(path); });
+    std::string savePath = path + ".save";
+    bench("io/save", nodes, bytes, [&] { model.save(savePath); });
+    std::cout.rdbuf(coutBuf);
+    std::remove(savePath.c_str());
+}
+
+static void benchHierarchy(const std::string &path) {
+    std::streambuf *coutBuf = std::cout.rdbuf(nullptr);
+    Model model;
+    model.load(path);
+    std::cout.rdbuf(coutBuf);
+    model.updateWorld();
+    double nodes = (double)model.hierarchy().size();
+
+    FlatHierarchy flat = model.hierarchy();
+    HierarchyUpdater updater;
+    bench("hierarchy/flatten", nodes, 0, [&] { flat.build(model.root.get()); });
+    bench("hierarchy/update_serial", nodes, 0, [&] { updater.updateSerial(flat); });
+    bench("hierarchy/update_parallel", nodes, 0, [&] { updater.update(flat); });
+    ModelBounds extent;
+    bench("hierarchy/bounds", nodes, 0, [&] { flat.boundsChanged.reset(flat.size()); extent.update(flat); });
+    DrawList list;
+    bench("hierarchy/draw_list", nodes, 0, [&] { fillDrawList(model, list); });
+
+    AABB bounds = model.bounds().box();
+    glm::vec3 dir, up;
+    viewDirection("iso", dir, up);
+    glm::mat4 viewProjection = framingMatrix(bounds, dir, up, 1.0f);
+    OcclusionCuller culler;
+    bench("hierarchy/draw_list_occlusion", nodes, 0, [&] { fillDrawList(model, list); culler.cull(list, viewProjection, 1.0f); });
+
+    // select every sphere, move them all and bring world matrices and bounds up to date
+    SelectionQuery spheres;
+    std::string error;
+    SelectionQuery::parse("type sphere", spheres, error);
+    bench("edit/batch_transform", nodes, 0, [&] {
+        applyTransform(model, selectNodes(model.hierarchy(), spheres), {TransformStep::TRANSLATE, 'Y', 0.01f});
+        model.bounds();
+    });
+}
+
+// MESHES: uploaded unit meshes (MeshBuffer). PROCEDURAL: generated in the vertex
+// shader (ProceduralRenderer). IMPOSTORS: meshes, but small spheres ray-cast (SphereImpostors).
+enum class FramePath { MESHES, PROCEDURAL, IMPOSTORS };
+
+static void benchHeadlessFrame(const std::string &path, FramePath mode) {
+    const char *suffix[] = {"", "_procedural", "_impostors"};
+    const std::string name = std::string("frame/headless_512") + suffix[(int)mode];
+    if (!config.filter.empty() && name.find(config.filter) == std::string::npos) return;
+    bool procedural = mode == FramePath::PROCEDURAL;
+    std::streambuf *coutBuf = std::cout.rdbuf(nullptr);
+    OffscreenContext ctx;
+    bool ok = ctx.create(512, 512);
+    GLuint program = ok ? loadShaderProgram(procedural ? "shaders/procedural_vshader.glsl" : "shaders/vshader.glsl", "shaders/fshader.glsl") : 0;
+    GLuint impostorProgram = ok && mode == FramePath::IMPOSTORS ? loadShaderProgram("shaders/impostor_vshader.glsl", "shaders/impostor_fshader.glsl") : 0;
+    Model model;
+    if (program) model.load(path);
+    std::cout.rdbuf(coutBuf);
+    if (!program || (mode == FramePath::IMPOSTORS && !impostorProgram)) { skipped(name, "no EGL/OpenGL 3.3 context"); return; }
+
+    glEnable(GL_DEPTH_TEST);
+    MeshBuffer meshes;
+    if (!procedural) meshes.preloadAll();
+    ProceduralRenderer generated;
+    SphereImpostors impostors;
+    DrawList list;
+    fillDrawList(model, list);
+    AABB bounds = model.bounds().box();
+    glm::vec3 dir, up;
+    viewDirection("iso", dir, up);
+    glm::mat4 viewProjection = framingMatrix(bounds, dir, up, 1.0f);
+    bench(name, (double)list.items.size(), 0, [&] {
+        fillDrawList(model, list);
+        if (impostorProgram) impostors.take(list, viewProjection, 512, 512);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        glUseProgram(program);
+        if (procedural) generated.submit(list, program, viewProjection);
+        else meshes.submit(list, program, viewProjection);
+        if (impostorProgram) {
+            glUseProgram(impostorProgram);
+            impostors.submit(impostorProgram);
+        }
+        glFinish();
+    });
+    glDeleteProgram(program);
+    if (impostorProgram) glDeleteProgram(impostorProgram);
+}
+
+// --- Determinism check ---
+// The pooled hierarchy update must give bit-identical world matrices and
+// bounds to the serial walk. Runs both on a deep and on a wide model, with the
+// pool forced on whatever the size and several task grains, and compares the
+// arrays byte for byte. Returns the exit code: 1 on any difference.
+static int checkHierarchy(const std::string &path) {
+    int failed = 0;
+    for (unsigned int depth : {12u, 2u}) {
+        writeBenchModel(path, depth);
+        std::streambuf *coutBuf = std::cout.rdbuf(nullptr);
+        Model model;
+        bool loaded = model.load(path);
+        std::cout.rdbuf(coutBuf);
+        if (!loaded) { std::cerr << "cannot load " << path << "\n"; return 2; }
+
+        FlatHierarchy serial;
+        serial.build(model.root.get());
+        HierarchyUpdater(nullptr).updateSerial(serial);
+        for (size_t grain : {1, 64, 2048}) {
+            FlatHierarchy pooled;
+            pooled.build(model.root.get());
+            HierarchyUpdater(&sharedPool(), 0, grain).update(pooled);
+            size_t n = serial.size();
+            bool same = std::memcmp(serial.world.data(), pooled.world.data(), n * sizeof(glm::mat4)) == 0 &&
+                        std::memcmp(serial.bounds.data(), pooled.bounds.data(), n * sizeof(AABB)) == 0;
+            std::printf("{\"name\":\"check/hierarchy_depth%u_grain%zu\",\"nodes\":%zu,\"identical\":%s}\n",
+                        depth, grain, n, same ? "true" : "false");
+            if (!same) failed = 1;
+        }
+    }
+    std::remove(path.c_str());
+    return failed;
+}
+
+int main(int argc, char **argv) {
+    bool hierarchyCheck = false;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--filter" && i + 1 < argc) config.filter = argv[++i];
+        else if (arg == "--check-hierarchy") hierarchyCheck = true;
+        else if (arg == "--nodes" && i + 1 < argc) config.nodes = std::stoul(argv[++i]);
+        else if (arg == "--min-time" && i + 1 < argc) config.minTime = std::stod(argv[++i]);
+        else { std::cerr << "Usage: " << argv[0] << " [--filter SUBSTRING] [--nodes N] [--min-time SECONDS] [--check-hierarchy]\n"; return 2; }
+    }
+
+    // In the temporary directory, named per process, so runs never write into
+    // the working directory or into each other's model.
+    std::string path = (std::filesystem::temp_directory_path() / ("modeller_bench_" + std::to_string(getpid()) + ".mod")).string();
+    if (hierarchyCheck) return checkHierarchy(path);
+    benchTessellation();
+    benchModelIO(path);
+    benchHierarchy(path);
+    benchHeadlessFrame(path, FramePath::MESHES);
+    benchHeadlessFrame(path, FramePath::PROCEDURAL);
+    benchHeadlessFrame(path, FramePath::IMPOSTORS);
+    std::remove(path.c_str());
+    return 0;
+}
@@ -0,0 +1,25 @@
+#version 330
+
+// Casts the pixel's ray back into the sphere's object space, where the
+// surface is |p| = 1 whatever the world matrix, and writes the hit's depth.
+
+noperspective in vec2 ndc;
+flat in mat4 inverseMVP;
+flat in vec4 rowZ;
+flat in vec4 rowW;
+flat in vec4 color;
+out vec4 frag_color;
+
+void main ()
+{
+  vec4 a = inverseMVP * vec4(ndc, -1.0, 1.0);
+  vec4 b = inverseMVP * vec4(ndc, 1.0, 1.0);
+  vec3 o = a.xyz / a.w;
+  vec3 d = b.xyz / b.w - o;
+  float qa = dot(d, d), qb = dot(o, d), qc = dot(o, o) - 1.0;
+  float disc = qb * qb - qa * qc;
+  if (disc < 0.0) discard;
+  vec4 p = vec4(o + d * ((-qb - sqrt(disc)) / qa), 1.0);
+  gl_FragDepth = 0.5 * dot(rowZ, p) / dot(rowW, p) + 0.5;
+  frag_color = color;
+}
@@ -0,0 +1,38 @@
+#version 330
+
+// Sphere impostors (see SphereImpostors in src/sphere_impostor.cpp). No
+// vertex attributes: the four corners of a triangle strip, from gl_VertexID,
+// span the screen rectangle of the instance's unit sphere, taken from the
+// eight corners of the cube around it. The fragment shader finds the surface.
+
+const int kBatch = 24;                // SphereImpostors::kBatch
+
+uniform mat4 ModelViewProjectMatrices[kBatch];
+uniform mat4 inverseMatrices[kBatch];
+uniform vec4 colors[kBatch];
+
+noperspective out vec2 ndc;
+flat out mat4 inverseMVP;
+flat out vec4 rowZ;                   // rows of the MVP giving clip z and w
+flat out vec4 rowW;
+flat out vec4 color;
+
+void main ()
+{
+  mat4 m = ModelViewProjectMatrices[gl_InstanceID];
+  vec2 lo = vec2(1e30), hi = vec2(-1e30);
+  float zmin = 1.0;
+  for (int k = 0; k < 8; k++) {
+    vec4 c = m * vec4((k & 1) != 0 ? 1.0 : -1.0, (k & 2) != 0 ? 1.0 : -1.0, (k & 4) != 0 ? 1.0 : -1.0, 1.0);
+    vec3 p = c.xyz / c.w;
+    lo = min(lo, p.xy);
+    hi = max(hi, p.xy);
+    zmin = min(zmin, p.z);
+  }
+  ndc = mix(lo, hi, vec2(gl_VertexID & 1, gl_VertexID >> 1));
+  gl_Position = vec4(ndc, zmin, 1.0);
+  inverseMVP = inverseMatrices[gl_InstanceID];
+  rowZ = vec4(m[0][2], m[1][2], m[2][2], m[3][2]);
+  rowW = vec4(m[0][3], m[1][3], m[2][3], m[3][3]);
+  color = colors[gl_InstanceID];
+}
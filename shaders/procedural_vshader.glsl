@@ -0,0 +1,69 @@
+#version 330
+
+// Bufferless primitives (see ProceduralRenderer in src/procedural_mesh.cpp).
+// No vertex attributes: each vertex of the unit mesh is worked out from
+// gl_VertexID, three per triangle, on the same grids as src/unit_mesh.cpp.
+// Each instance's matrix and colour come from the uniform arrays, indexed by
+// gl_InstanceID.
+
+const int kBatch = 48;                // ProceduralRenderer::kBatch
+const float PI = 3.14159265358979;
+
+uniform int shape;                    // 0 sphere, 1 cylinder, 2 box, 3 cone
+uniform int divisions;                // 1 << (level - 1)
+uniform mat4 ModelViewProjectMatrices[kBatch];
+uniform vec4 colors[kBatch];
+out vec4 color;
+
+// Grid step (i, j) of each corner of a quad's two triangles.
+const ivec2 sphereCorner[6] = ivec2[6](ivec2(0,0), ivec2(0,1), ivec2(1,0), ivec2(0,1), ivec2(1,1), ivec2(1,0));
+const ivec2 boxCorner[6] = ivec2[6](ivec2(0,0), ivec2(1,0), ivec2(1,1), ivec2(0,0), ivec2(1,1), ivec2(0,1));
+
+// Origin corner, u and v edge of each box face.
+const vec3 boxOrigin[6] = vec3[6](vec3( 0.5,-0.5,-0.5), vec3(-0.5,-0.5,-0.5), vec3(-0.5, 0.5,-0.5),
+                                  vec3(-0.5,-0.5,-0.5), vec3(-0.5,-0.5, 0.5), vec3(-0.5,-0.5,-0.5));
+const vec3 boxU[6] = vec3[6](vec3(0,1,0), vec3(0,0,1), vec3(0,0,1), vec3(1,0,0), vec3(1,0,0), vec3(0,1,0));
+const vec3 boxV[6] = vec3[6](vec3(0,0,1), vec3(0,1,0), vec3(1,0,0), vec3(0,0,1), vec3(0,1,0), vec3(1,0,0));
+
+// (ring step, y) of each vertex of one segment; step -1 is the point on the axis.
+// Cylinder: bottom cap, top cap, two side triangles. Cone: base, side.
+const vec2 cylinderCorner[12] = vec2[12](vec2(-1,-0.5), vec2(0,-0.5), vec2(1,-0.5),
+                                         vec2(-1, 0.5), vec2(1, 0.5), vec2(0, 0.5),
+                                         vec2(0,-0.5), vec2(0, 0.5), vec2(1,-0.5),
+                                         vec2(1,-0.5), vec2(0, 0.5), vec2(1, 0.5));
+const vec2 coneCorner[6] = vec2[6](vec2(-1,0), vec2(0,0), vec2(1,0), vec2(0,0), vec2(-1,1), vec2(1,0));
+
+vec3 spherePoint(int v, int d) {
+    int latDiv = 8 * d, longDiv = 16 * d;
+    int quad = v / 6;
+    ivec2 c = sphereCorner[v % 6];
+    float theta = PI * float(quad / longDiv + c.x) / float(latDiv);
+    float phi = 2.0 * PI * float(quad % longDiv + c.y) / float(longDiv);
+    return vec3(sin(theta) * cos(phi), cos(theta), sin(theta) * sin(phi));
+}
+
+vec3 boxPoint(int v, int d) {
+    int quad = v / 6;
+    int face = quad / (d * d), q = quad % (d * d);
+    ivec2 c = boxCorner[v % 6];
+    return boxOrigin[face] + boxU[face] * (float(q / d + c.x) / float(d)) + boxV[face] * (float(q % d + c.y) / float(d));
+}
+
+vec3 ringPoint(vec2 c, int segment, int div) {
+    if (c.x < 0.0) return vec3(0.0, c.y, 0.0);
+    float theta = 2.0 * PI * float((segment + int(c.x)) % div) / float(div);
+    return vec3(cos(theta), c.y, sin(theta));
+}
+
+void main ()
+{
+  int v = gl_VertexID;
+  int d = divisions;
+  vec3 p;
+  if (shape == 0) p = spherePoint(v, d);
+  else if (shape == 2) p = boxPoint(v, d);
+  else if (shape == 1) p = ringPoint(cylinderCorner[v % 12], v / 12, 16 * d);
+  else p = ringPoint(coneCorner[v % 6], v / 6, 16 * d);
+  gl_Position = ModelViewProjectMatrices[gl_InstanceID] * vec4(p, 1.0);
+  color = colors[gl_InstanceID];
+}
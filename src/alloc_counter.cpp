@@ -0,0 +1,77 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+// --- Allocation counting ---
+// Built with -DMODELLER_COUNT_ALLOCATIONS (debug and alloc-check builds), this file
+// replaces the global operator new and counts every call on every thread.
+// Steady-state frames are meant to allocate nothing: allocator locks and page
+// faults show up as frame-time spikes, so the frame path reuses its storage
+// and `make alloc-check` fails if an idle or camera-only frame allocates.
+//
+// The replacements are not inline, so a program may only have one translation
+// unit including this, as main.cpp is. Without the define it replaces nothing
+// and allocationCount() stays 0.
+
+namespace alloc {
+
+#ifdef MODELLER_COUNT_ALLOCATIONS
+constexpr bool kCounting = true;
+#else
+constexpr bool kCounting = false;
+#endif
+
+inline std::atomic<uint64_t>& counter() {
+    static std::atomic<uint64_t> count{0};
+    return count;
+}
+
+inline uint64_t allocationCount() { return counter().load(std::memory_order_relaxed); }
+
+// Allocations made (by any thread) since construction.
+class Scope {
+public:
+    Scope() : start(allocationCount()) {}
+    uint64_t allocations() const { return allocationCount() - start; }
+
+private:
+    uint64_t start;
+};
+
+inline void* countedAlloc(std::size_t size) {
+    counter().fetch_add(1, std::memory_order_relaxed);
+    return std::malloc(size ? size : 1);
+}
+
+} // namespace alloc
+
+#ifdef MODELLER_COUNT_ALLOCATIONS
+// Over-aligned (align_val_t) forms keep the library versions and are not
+// counted; nothing in the frame path uses over-aligned types.
+void* operator new(std::size_t size) {
+    if (void *p = alloc::countedAlloc(size)) return p;
+    throw std::bad_alloc();
+}
+void* operator new[](std::size_t size) {
+    if (void *p = alloc::countedAlloc(size)) return p;
+    throw std::bad_alloc();
+}
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept { return alloc::countedAlloc(size); }
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept { return alloc::countedAlloc(size); }
+// GCC flags free() on operator new's result once these are inlined, not
+// knowing that operator new is the malloc above.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete[](void *p) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void *p, std::size_t) noexcept { std::free(p); }
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+#endif
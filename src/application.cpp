@@ -32,6 +32,10 @@ Application::Application() {
 }
 
 Application::~Application() {
+    shaders.reset(); // releases the compile context first
+    if (compileContext) {
+        glfwDestroyWindow(compileContext);
+    }
     if (window) {
         glfwDestroyWindow(window);
     }
@@ -76,7 +80,16 @@ void Application::init() {
     // Initialize subsystems
     renderer = std::make_unique<Renderer>();
     camera = std::make_unique<Camera>(glm::vec3(0.0f, 2.0f, 10.0f));
-    shader = std::make_unique<Shader>("shaders/simple.vert", "shaders/simple.frag");
+
+    // One program for the scene and the baked model, loaded through the
+    // program binary cache and rebuilt on a hidden shared context whenever
+    // the files change (see ShaderReloader).
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    compileContext = glfwCreateWindow(1, 1, "", nullptr, window);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+    GLFWwindow* context = compileContext;
+    shaders = std::make_unique<ShaderReloader>("shaders/vshader.glsl", "shaders/fshader.glsl",
+        [context](bool use) { glfwMakeContextCurrent(use ? context : nullptr); });
 
     // Initial OpenGL state
     glEnable(GL_DEPTH_TEST);
@@ -89,18 +102,22 @@ void Application::run() {
     while (!glfwWindowShouldClose(window)) {
         // Event handling
         glfwPollEvents();
+        shaders->poll();
 
         // Rendering
         renderer->clear();
-        shader->use();
+        GLuint program = shaders->program();
+        glUseProgram(program);
 
         // Set camera uniforms
-        shader->setMat4("projection", camera->getProjectionMatrix());
-        shader->setMat4("view", camera->getViewMatrix());
+        glm::mat4 projection = camera->getProjectionMatrix(), view = camera->getViewMatrix();
+        glUniformMatrix4fv(glGetUniformLocation(program, "projection"), 1, GL_FALSE, &projection[0][0]);
+        glUniformMatrix4fv(glGetUniformLocation(program, "view"), 1, GL_FALSE, &view[0][0]);
 
         // Draw the model
         if (model) {
-            renderer->drawModel(*model, *shader);
+            renderer->drawModel(*model, program);
+            model->drawBaked(program, projection * view);
         }
 
         // Swap buffers
@@ -120,12 +137,14 @@ void Application::onKey(int key, int scancode, int action, int mods) {
     }
     if (key == GLFW_KEY_M) {
         currentMode = AppMode::MODELLING;
+        model->dropBaked();
         resetTransformState();
         std::cout << "\n--- Switched to MODELLING Mode ---" << std::endl;
         return;
     }
     if (key == GLFW_KEY_I) {
         currentMode = AppMode::INSPECTION;
+        model->bakeForInspection();
         resetTransformState();
         std::cout << "\n--- Switched to INSPECTION Mode ---" << std::endl;
         return;
@@ -301,6 +320,7 @@ void Application::loadModel() {
     auto newModel = std::make_unique<model_t>();
     if (newModel->loadFromFile(filename)) {
         model = std::move(newModel);
+        model->bakeForInspection();
         std::cout << "Model loaded from " << filename << std::endl;
         // Frame the newly loaded model so it's visible
         camera->frameModel(*model);
@@ -0,0 +1,307 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "model.cpp"
+#include "unit_mesh.cpp"
+#include "mesh_export.cpp"
+#include "interference.cpp"
+
+// --- Windowless batch processing ---
+// Runs one action over many .mod files (directories are searched recursively):
+//
+//   modeller --validate [--jobs N] PATH...
+//   modeller --stats [--jobs N] PATH...                      (one JSON object per file)
+//   modeller --convert --out DIR [--jobs N] PATH...          (rewrite in canonical .mod form)
+//   modeller --retessellate LEVEL --out DIR [--jobs N] PATH...
+//   modeller --export stl|gltf --out DIR [--jobs N] PATH...  (triangle meshes, see mesh_export.cpp)
+//   modeller --interference [--jobs N] PATH...                (overlapping shapes, see interference.cpp)
+//
+// Files are handed out one at a time to N workers, so at most N models are in
+// memory at once however many files are given. Results are printed as each file
+// finishes; the exit code is 1 if any file failed, or for --interference, if
+// any file has overlapping shapes.
+
+enum class BatchAction { VALIDATE, STATS, CONVERT, RETESSELLATE, EXPORT, INTERFERENCE };
+
+struct BatchOptions {
+    BatchAction action = BatchAction::VALIDATE;
+    unsigned int jobs = std::thread::hardware_concurrency();
+    unsigned int level = 1;      // --retessellate
+    std::string format;          // --export: "stl" or "gltf"
+    std::string outDir;          // --convert / --retessellate / --export
+    std::vector<std::string> inputs;
+};
+
+struct BatchFile {
+    std::string path;
+    std::string relative;        // output path under --out, keeps the input directory layout
+};
+
+// Outputs are written to NAME.tmp and renamed into place once complete, as
+// Model::save does, so a failed or interrupted run never leaves a truncated
+// file where a good one is expected. `ok` says whether writing the temporary
+// files succeeded; they are removed if it did not or a rename fails.
+inline std::filesystem::path partialPath(const std::filesystem::path &out) { return out.string() + ".tmp"; }
+
+inline bool finishOutputs(const std::vector<std::filesystem::path> &outs, bool ok) {
+    std::error_code ec;
+    for (auto &out : outs) {
+        if (!ok) break;
+        std::filesystem::rename(partialPath(out), out, ec);
+        ok = !ec;
+    }
+    if (!ok) for (auto &out : outs) std::filesystem::remove(partialPath(out), ec);
+    return ok;
+}
+
+inline bool isBatchAction(const std::string &arg) {
+    return arg == "--validate" || arg == "--stats" || arg == "--convert" || arg == "--retessellate" || arg == "--export" ||
+           arg == "--interference";
+}
+
+inline bool parseBatchOptions(int argc, char **argv, BatchOptions &opt) {
+    for (int i = 0; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--validate") opt.action = BatchAction::VALIDATE;
+        else if (arg == "--stats") opt.action = BatchAction::STATS;
+        else if (arg == "--convert") opt.action = BatchAction::CONVERT;
+        else if (arg == "--interference") opt.action = BatchAction::INTERFERENCE;
+        else if (arg == "--retessellate" && i + 1 < argc) {
+            opt.action = BatchAction::RETESSELLATE;
+            std::istringstream ss(argv[++i]);
+            if (!(ss >> opt.level) || opt.level < 1 || opt.level > Model::kMaxLevel) {
+                std::cerr << "Invalid --retessellate level, expected 1-" << Model::kMaxLevel << "\n";
+                return false;
+            }
+        }
+        else if (arg == "--export" && i + 1 < argc) {
+            opt.action = BatchAction::EXPORT;
+            opt.format = argv[++i];
+            if (opt.format != "stl" && opt.format != "gltf") { std::cerr << "Invalid --export format, expected stl or gltf\n"; return false; }
+        }
+        else if (arg == "--jobs" && i + 1 < argc) {
+            std::istringstream ss(argv[++i]);
+            if (!(ss >> opt.jobs) || opt.jobs == 0) { std::cerr << "Invalid --jobs\n"; return false; }
+        }
+        else if (arg == "--out" && i + 1 < argc) opt.outDir = argv[++i];
+        else if (arg.rfind("--", 0) == 0) { std::cerr << "Unknown option " << arg << "\n"; return false; }
+        else opt.inputs.push_back(arg);
+    }
+    if (opt.jobs == 0) opt.jobs = 1;
+    bool writes = opt.action == BatchAction::CONVERT || opt.action == BatchAction::RETESSELLATE || opt.action == BatchAction::EXPORT;
+    if (writes && opt.outDir.empty()) { std::cerr << "--convert, --retessellate and --export need --out DIR\n"; return false; }
+    if (opt.inputs.empty()) { std::cerr << "No .mod files or directories given\n"; return false; }
+    return true;
+}
+
+inline bool collectBatchFiles(const std::vector<std::string> &inputs, std::vector<BatchFile> &files) {
+    namespace fs = std::filesystem;
+    for (auto &input : inputs) {
+        std::error_code ec;
+        if (fs::is_directory(input, ec)) {
+            for (fs::recursive_directory_iterator it(input, ec), end; !ec && it != end; it.increment(ec)) {
+                if (!it->is_regular_file(ec) || it->path().extension() != ".mod") continue;
+                files.push_back({it->path().string(), fs::relative(it->path(), input, ec).string()});
+            }
+            if (ec) { std::cerr << "Cannot read directory " << input << ": " << ec.message() << "\n"; return false; }
+        } else {
+            files.push_back({input, fs::path(input).filename().string()});
+        }
+    }
+    return true;
+}
+
+// Replaces every shape by one of the same type, transform and colour at `level`.
+// Instances are not followed; their definitions are retessellated once, separately.
+inline void retessellate(const std::shared_ptr<HNode> &node, unsigned int level) {
+    if (!node) return;
+    if (auto &s = node->getShape()) node->setShape(Model::copyShape(*s, level));
+    for (auto &c : node->getChildren()) retessellate(c, level);
+}
+
+class BatchRunner {
+public:
+    explicit BatchRunner(const BatchOptions &opt) : opt(opt) {
+        // Unit mesh sizes are looked up per node; fill the table once, up front.
+        for (int t = 0; t < 4; t++)
+            for (unsigned int l = 1; l <= Model::kMaxLevel; l++)
+                triangles[t][l] = unitTriangleCount((ShapeType)t, l);
+    }
+
+    // Returns the process exit code.
+    int run(const std::vector<BatchFile> &files) {
+        auto start = std::chrono::steady_clock::now();
+        single = files.size() == 1;
+        unsigned int workers = std::min<size_t>(opt.jobs, std::max<size_t>(files.size(), 1));
+        WorkStealingPool pool(workers);
+        TaskGroup group;
+        // One long-running task per worker pulling the next file: no more than
+        // `workers` models are ever alive, and a slow file never blocks the rest.
+        for (unsigned int w = 0; w < workers; w++) {
+            pool.submit(group, [&] {
+                for (size_t i; (i = next.fetch_add(1)) < files.size(); ) process(files[i]);
+            });
+        }
+        pool.wait(group);
+
+        double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cerr << files.size() << " file(s), " << failed.load() << " failed, ";
+        if (opt.action == BatchAction::INTERFERENCE) std::cerr << overlapping.load() << " with overlapping shapes, ";
+        std::cerr << s << " s\n";
+        return failed.load() || overlapping.load() ? 1 : 0;
+    }
+
+private:
+    const BatchOptions &opt;
+    size_t triangles[4][Model::kMaxLevel + 1] = {};
+    std::atomic<size_t> next{0};
+    std::atomic<size_t> failed{0};
+    std::atomic<size_t> overlapping{0};   // --interference: files checked and found to have overlaps
+    bool single = false;         // one file: per-file work may use the shared pool
+    std::mutex outputMutex;
+
+    void report(const std::string &line, bool ok) {
+        if (!ok) failed++;
+        std::lock_guard<std::mutex> lock(outputMutex);
+        (ok ? std::cout : std::cerr) << line << "\n";
+    }
+
+    void process(const BatchFile &file) {
+        std::ifstream in(file.path);
+        if (!in) { report(file.path + ": cannot open", false); return; }
+        Model model;
+        std::string error;
+        if (!model.read(in, error)) { report(file.path + ":" + error, false); return; }
+        in.close();
+        if (!model.root) { report(file.path + ": no nodes", false); return; }
+
+        switch (opt.action) {
+        case BatchAction::VALIDATE: report(file.path + ": ok", true); break;
+        case BatchAction::STATS: report(stats(file.path, model), true); break;
+        case BatchAction::RETESSELLATE:
+            retessellate(model.root, opt.level);
+            for (auto &d : model.definitions) retessellate(d.second, opt.level);
+            [[fallthrough]];
+        case BatchAction::CONVERT: {
+            namespace fs = std::filesystem;
+            fs::path out = fs::path(opt.outDir) / file.relative;
+            std::error_code ec;
+            fs::create_directories(out.parent_path(), ec);
+            bool ok;
+            {
+                std::ofstream o(partialPath(out));
+                ok = o && model.write(o);
+                o.close();
+                ok = ok && !o.fail();
+            }
+            if (!finishOutputs({out}, ok)) { report(file.path + ": cannot write " + out.string(), false); return; }
+            report(file.path + " -> " + out.string(), true);
+            break;
+        }
+        case BatchAction::EXPORT: exportMesh(file, model); break;
+        case BatchAction::INTERFERENCE: interference(file.path, model); break;
+        }
+    }
+
+    void exportMesh(const BatchFile &file, const Model &model) {
+        namespace fs = std::filesystem;
+        fs::path out = (fs::path(opt.outDir) / file.relative).replace_extension(opt.format);
+        std::error_code ec;
+        fs::create_directories(out.parent_path(), ec);
+        std::vector<fs::path> outs{out};
+        bool ok;
+        {
+            std::ofstream o(partialPath(out), std::ios::binary);
+            ok = (bool)o;
+            if (ok && opt.format == "stl") ok = exportStl(model, o);
+            else if (ok) {
+                fs::path binPath = fs::path(out).replace_extension("bin");
+                outs.insert(outs.begin(), binPath);   // renamed first, so the .gltf never names a missing .bin
+                std::ofstream bin(partialPath(binPath), std::ios::binary);
+                ok = bin && GltfExporter().write(model, o, bin, binPath.filename().string());
+                bin.close();
+                ok = ok && !bin.fail();
+            }
+            o.close();
+            ok = ok && !o.fail();
+        }
+        if (!finishOutputs(outs, ok)) { report(file.path + ": cannot write " + out.string(), false); return; }
+        report(file.path + " -> " + out.string(), true);
+    }
+
+    // One JSON object per file; pairs are pre-order node indices, as in FlatHierarchy.
+    void interference(const std::string &path, const Model &model) {
+        FlatHierarchy flat;
+        flat.build(model.root.get());
+        WorkStealingPool *pool = single ? &sharedPool() : nullptr;   // else files run in parallel already
+        HierarchyUpdater(pool).update(flat);
+        std::vector<InterferenceItem> items = interferenceItems(flat);
+        InterferenceChecker::Result r = InterferenceChecker(pool).check(items);
+
+        std::ostringstream o;
+        o << "{\"file\":\"";
+        for (char c : path) { if (c == '"' || c == '\\') o << '\\'; o << c; }
+        o << "\",\"shapes\":" << items.size() << ",\"candidates\":" << r.candidates
+          << ",\"interferences\":" << r.pairs.size() << ",\"pairs\":[";
+        for (size_t i = 0; i < r.pairs.size(); i++) o << (i ? ",[" : "[") << r.pairs[i].first << "," << r.pairs[i].second << "]";
+        o << "]}";
+        if (!r.pairs.empty()) overlapping++;
+        report(o.str(), true);
+    }
+
+    std::string stats(const std::string &path, const Model &model) {
+        FlatHierarchy flat;
+        flat.build(model.root.get());
+        HierarchyUpdater(nullptr).update(flat); // files run in parallel already; stay serial per file
+
+        std::vector<unsigned int> depth(flat.size(), 0);
+        unsigned int maxDepth = 0;
+        size_t byType[4] = {}, byLevel[Model::kMaxLevel + 1] = {}, tris = 0;
+        AABB bounds;
+        for (size_t i = 0; i < flat.size(); i++) {
+            if (flat.parent[i] >= 0) depth[i] = depth[flat.parent[i]] + 1;
+            maxDepth = std::max(maxDepth, depth[i] + 1);
+            bounds.expand(flat.bounds[i]);
+            const Shape *s = flat.shapes[i];
+            if (!s) continue;
+            unsigned int level = std::min(std::max(s->getLevel(), 1u), Model::kMaxLevel);
+            byType[(int)s->shapetype]++;
+            byLevel[level]++;
+            tris += triangles[(int)s->shapetype][level];
+        }
+
+        std::ostringstream o;
+        o << "{\"file\":\"";
+        for (char c : path) { if (c == '"' || c == '\\') o << '\\'; o << c; }
+        o << "\",\"nodes\":" << flat.size() << ",\"depth\":" << maxDepth
+          << ",\"spheres\":" << byType[0] << ",\"cylinders\":" << byType[1]
+          << ",\"boxes\":" << byType[2] << ",\"cones\":" << byType[3] << ",\"levels\":[";
+        for (unsigned int l = 1; l <= Model::kMaxLevel; l++) o << (l > 1 ? "," : "") << byLevel[l];
+        o << "],\"triangles\":" << tris;
+        if (!bounds.empty())
+            o << ",\"min\":[" << bounds.min.x << "," << bounds.min.y << "," << bounds.min.z
+              << "],\"max\":[" << bounds.max.x << "," << bounds.max.y << "," << bounds.max.z << "]";
+        o << "}";
+        return o.str();
+    }
+};
+
+// Entry point for the batch actions. Returns the process exit code.
+inline int runBatch(int argc, char **argv) {
+    BatchOptions opt;
+    if (!parseBatchOptions(argc, argv, opt)) return 2;
+    std::vector<BatchFile> files;
+    if (!collectBatchFiles(opt.inputs, files)) return 1;
+    return BatchRunner(opt).run(files);
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <cfloat>
+#include <cmath>
+
+// Axis-aligned bounding box. Starts out empty (min > max) so expand() just works.
+struct AABB {
+    glm::vec3 min = glm::vec3(FLT_MAX);
+    glm::vec3 max = glm::vec3(-FLT_MAX);
+
+    bool empty() const { return min.x > max.x; }
+    glm::vec3 center() const { return (min + max) * 0.5f; }
+    glm::vec3 extent() const { return (max - min) * 0.5f; }
+
+    void expand(const glm::vec3 &p) { min = glm::min(min, p); max = glm::max(max, p); }
+    void expand(const AABB &b) { min = glm::min(min, b.min); max = glm::max(max, b.max); }
+};
+
+// Bounds of the unit mesh each primitive is built from (see Model::load):
+// Sphere(1), Box(1), Cylinder(1,1) centred on the origin, Cone(1,1) standing on y=0.
+inline AABB unitBounds(ShapeType type) {
+    AABB b;
+    switch (type) {
+        case ShapeType::SPHERE_SHAPE:   b.min = glm::vec3(-1.0f);             b.max = glm::vec3(1.0f); break;
+        case ShapeType::BOX_SHAPE:      b.min = glm::vec3(-0.5f);             b.max = glm::vec3(0.5f); break;
+        case ShapeType::CYLINDER_SHAPE: b.min = glm::vec3(-1.0f,-0.5f,-1.0f); b.max = glm::vec3(1.0f,0.5f,1.0f); break;
+        case ShapeType::CONE_SHAPE:     b.min = glm::vec3(-1.0f, 0.0f,-1.0f); b.max = glm::vec3(1.0f,1.0f,1.0f); break;
+    }
+    return b;
+}
+
+// Transform a box by an affine matrix (Arvo): centre goes through m, extents through |m|.
+inline AABB transformBounds(const glm::mat4 &m, const AABB &b) {
+    if (b.empty()) return b;
+    glm::vec3 c = glm::vec3(m * glm::vec4(b.center(), 1.0f));
+    glm::vec3 e = b.extent();
+    glm::vec3 r(
+        std::fabs(m[0][0])*e.x + std::fabs(m[1][0])*e.y + std::fabs(m[2][0])*e.z,
+        std::fabs(m[0][1])*e.x + std::fabs(m[1][1])*e.y + std::fabs(m[2][1])*e.z,
+        std::fabs(m[0][2])*e.x + std::fabs(m[1][2])*e.y + std::fabs(m[2][2])*e.z);
+    AABB out;
+    out.min = c - r;
+    out.max = c + r;
+    return out;
+}
+
+// View frustum as six inward-facing planes taken from a projection * view matrix
+// (Gribb & Hartmann). A box is culled only if it lies entirely behind one plane,
+// so the test is conservative near the frustum's edges.
+struct Frustum {
+    glm::vec4 planes[6];
+
+    explicit Frustum(const glm::mat4 &m) {
+        for (int i = 0; i < 3; i++) {
+            for (int k = 0; k < 4; k++) {
+                planes[2*i][k]   = m[k][3] + m[k][i];
+                planes[2*i+1][k] = m[k][3] - m[k][i];
+            }
+        }
+    }
+
+    bool intersects(const AABB &b) const {
+        if (b.empty()) return false;
+        glm::vec3 c = b.center(), e = b.extent();
+        for (const glm::vec4 &p : planes) {
+            float r = e.x * std::fabs(p.x) + e.y * std::fabs(p.y) + e.z * std::fabs(p.z);
+            if (p.x * c.x + p.y * c.y + p.z * c.z + p.w < -r) return false;
+        }
+        return true;
+    }
+};
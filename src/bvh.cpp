@@ -0,0 +1,126 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "bounds.cpp"
+
+// Bounding volume hierarchy over a list of boxes (one per item).
+// Built top-down by splitting the longest axis of the centroid bounds at the
+// median; nodes live in one array, and each leaf covers a contiguous run of
+// `items`, so a traversal touches no pointers.
+class BVH {
+public:
+    struct Node {
+        AABB box;
+        uint32_t first;   // leaf: first entry in items; inner: index of the left child (right = first + 1)
+        uint32_t count;   // 0 for inner nodes
+    };
+
+    std::vector<Node> nodes;
+    std::vector<uint32_t> items;   // item indices, grouped by leaf
+
+    static const uint32_t kLeafSize = 4;
+
+    // Items with empty boxes are left out.
+    void build(const std::vector<AABB> &boxes) {
+        nodes.clear();
+        items.clear();
+        centroids.resize(boxes.size());
+        for (uint32_t i = 0; i < boxes.size(); i++) {
+            if (boxes[i].empty()) continue;
+            items.push_back(i);
+            centroids[i] = boxes[i].center();
+        }
+        if (items.empty()) return;
+        nodes.reserve(2 * items.size() / kLeafSize + 1);
+        nodes.push_back({AABB(), 0, (uint32_t)items.size()});
+
+        // Explicit stack of nodes still to split.
+        std::vector<uint32_t> stack{0};
+        while (!stack.empty()) {
+            uint32_t n = stack.back();
+            stack.pop_back();
+            uint32_t first = nodes[n].first, count = nodes[n].count;
+            AABB box, centres;
+            for (uint32_t k = first; k < first + count; k++) {
+                box.expand(boxes[items[k]]);
+                centres.expand(centroids[items[k]]);
+            }
+            nodes[n].box = box;
+            if (count <= kLeafSize) continue;
+
+            glm::vec3 size = centres.max - centres.min;
+            int axis = size.x > size.y ? (size.x > size.z ? 0 : 2) : (size.y > size.z ? 1 : 2);
+            if (size[axis] <= 0.0f) continue; // all centres coincide: keep as one leaf
+            uint32_t mid = first + count / 2;
+            std::nth_element(items.begin() + first, items.begin() + mid, items.begin() + first + count,
+                             [&](uint32_t a, uint32_t b) { return centroids[a][axis] < centroids[b][axis]; });
+
+            uint32_t left = (uint32_t)nodes.size();
+            nodes.push_back({AABB(), first, mid - first});
+            nodes.push_back({AABB(), mid, first + count - mid});
+            nodes[n].first = left;
+            nodes[n].count = 0;
+            stack.push_back(left);
+            stack.push_back(left + 1);
+        }
+        centroids.clear();
+        centroids.shrink_to_fit();
+    }
+
+    bool empty() const { return nodes.empty(); }
+
+    // Slab test; returns the entry distance in tNear if the ray meets the box before tMax.
+    static bool rayBox(const AABB &b, const glm::vec3 &origin, const glm::vec3 &invDir, float tMax, float &tNear) {
+        glm::vec3 t0 = (b.min - origin) * invDir;
+        glm::vec3 t1 = (b.max - origin) * invDir;
+        glm::vec3 lo = glm::min(t0, t1), hi = glm::max(t0, t1);
+        tNear = std::max(std::max(lo.x, lo.y), std::max(lo.z, 0.0f));
+        float tFar = std::min(std::min(hi.x, hi.y), std::min(hi.z, tMax));
+        return tNear <= tFar;
+    }
+
+    // Front-to-back traversal. hit(item, tBest) runs the exact test for one item and
+    // returns true (after lowering tBest) if it found a closer hit; boxes beyond the
+    // closest hit so far are skipped. Returns the nearest item, or -1.
+    template <typename HitFn>
+    int raycast(const glm::vec3 &origin, const glm::vec3 &dir, float &tBest, HitFn hit) const {
+        if (nodes.empty()) return -1;
+        glm::vec3 invDir(1.0f / dir.x, 1.0f / dir.y, 1.0f / dir.z);
+        int best = -1;
+        float tNear;
+        if (!rayBox(nodes[0].box, origin, invDir, tBest, tNear)) return -1;
+
+        struct Entry { uint32_t node; float t; };
+        Entry stack[64];
+        int top = 0;
+        stack[top++] = {0, tNear};
+        while (top > 0) {
+            Entry e = stack[--top];
+            if (e.t > tBest) continue;
+            const Node &n = nodes[e.node];
+            if (n.count > 0) {
+                for (uint32_t k = n.first; k < n.first + n.count; k++)
+                    if (hit(items[k], tBest)) best = (int)items[k];
+                continue;
+            }
+            float tl, tr;
+            bool hl = rayBox(nodes[n.first].box, origin, invDir, tBest, tl);
+            bool hr = rayBox(nodes[n.first + 1].box, origin, invDir, tBest, tr);
+            // push the farther child first so the nearer one is visited next
+            if (hl && hr) {
+                if (tl < tr) { stack[top++] = {n.first + 1, tr}; stack[top++] = {n.first, tl}; }
+                else { stack[top++] = {n.first, tl}; stack[top++] = {n.first + 1, tr}; }
+            }
+            else if (hl) stack[top++] = {n.first, tl};
+            else if (hr) stack[top++] = {n.first + 1, tr};
+        }
+        return best;
+    }
+
+private:
+    std::vector<glm::vec3> centroids;
+};
@@ -1,3 +1,5 @@
+#pragma once
+
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <vector>
@@ -5,21 +7,22 @@
 #include <cmath>
 #include <sstream>
 
+#include "tessellation_level.cpp"
+
 // Cylinder class inheriting from Shape (assume Shape has draw(), translate(), rotate(), scale(), setColor(), serialize() pure virtual)
+// Only the parameters live here; the mesh for the level comes from UnitMeshCache,
+// so creating or copying a cylinder never tessellates.
 class Cylinder : public Shape {
 public:
     Cylinder(float radius, float height, unsigned int level) {
         this->shapetype = ShapeType::CYLINDER_SHAPE;
-        this->level = std::min(std::max(level, 1u), 4u);
+        this->level = clampLevel(level);
 
         baseRadius = radius;
         baseHeight = height;
         scaleFactors = glm::vec3(1.0f, 1.0f, 1.0f);
         centroid = glm::vec3(0.0f, 0.0f, 0.0f);
         color = glm::vec3(1.0f, 1.0f, 1.0f);
-
-        generateBaseMesh(); // generate unscaled vertices
-        updateVertices();   // apply initial scale
     }
 
     void draw() override {
@@ -48,12 +51,10 @@ public:
         if(axis=='X') scaleFactors.x *= factor;
         else if(axis=='Y') scaleFactors.y *= factor;
         else if(axis=='Z') scaleFactors.z *= factor;
-        updateVertices();
     }
 
     void setColor(glm::vec3 col) override {
         color = col;
-        for(auto& c : colors) c = glm::vec4(color, 1.0f);
     }
 
     std::string serialize() override {
@@ -72,61 +73,4 @@ private:
     glm::vec3 centroid;
     glm::vec3 color;
     glm::mat4 model;
-
-    std::vector<glm::vec4> baseVertices; // unit cylinder mesh
-    std::vector<glm::vec4> vertices;
-    std::vector<glm::vec4> colors;
-
-    void generateBaseMesh() {
-        baseVertices.clear();
-
-        unsigned int baseDiv = 16 * (1<<(level-1)); // 16,32,64,128 triangles
-        float halfH = baseHeight/2.0f;
-
-        // Base cap
-        for(unsigned int i=0;i<baseDiv;i++){
-            float theta1 = 2.0f * M_PI * i / baseDiv;
-            float theta2 = 2.0f * M_PI * (i+1) / baseDiv;
-
-            baseVertices.push_back(glm::vec4(0.0f,-halfH,0.0f,1.0f));
-            baseVertices.push_back(glm::vec4(baseRadius*cos(theta1),-halfH,baseRadius*sin(theta1),1.0f));
-            baseVertices.push_back(glm::vec4(baseRadius*cos(theta2),-halfH,baseRadius*sin(theta2),1.0f));
-        }
-
-        // Top cap
-        for(unsigned int i=0;i<baseDiv;i++){
-            float theta1 = 2.0f * M_PI * i / baseDiv;
-            float theta2 = 2.0f * M_PI * (i+1) / baseDiv;
-
-            baseVertices.push_back(glm::vec4(0.0f,halfH,0.0f,1.0f));
-            baseVertices.push_back(glm::vec4(baseRadius*cos(theta2),halfH,baseRadius*sin(theta2),1.0f));
-            baseVertices.push_back(glm::vec4(baseRadius*cos(theta1),halfH,baseRadius*sin(theta1),1.0f));
-        }
-
-        // Curved surface
-        for(unsigned int i=0;i<baseDiv;i++){
-            float theta1 = 2.0f * M_PI * i / baseDiv;
-            float theta2 = 2.0f * M_PI * (i+1) / baseDiv;
-
-            glm::vec4 v1(baseRadius*cos(theta1),-halfH,baseRadius*sin(theta1),1.0f);
-            glm::vec4 v2(baseRadius*cos(theta2),-halfH,baseRadius*sin(theta2),1.0f);
-            glm::vec4 v3(baseRadius*cos(theta1),halfH,baseRadius*sin(theta1),1.0f);
-            glm::vec4 v4(baseRadius*cos(theta2),halfH,baseRadius*sin(theta2),1.0f);
-
-            // first triangle
-            baseVertices.push_back(v1); baseVertices.push_back(v3); baseVertices.push_back(v2);
-            // second triangle
-            baseVertices.push_back(v2); baseVertices.push_back(v3); baseVertices.push_back(v4);
-        }
-    }
-
-    void updateVertices() {
-        vertices.clear();
-        colors.clear();
-        for(auto &v : baseVertices){
-            glm::vec4 scaledV(v.x*scaleFactors.x, v.y*scaleFactors.y, v.z*scaleFactors.z, 1.0f);
-            vertices.push_back(scaledV);
-            colors.push_back(glm::vec4(color,1.0f));
-        }
-    }
 };
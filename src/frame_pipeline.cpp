@@ -0,0 +1,138 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "model.cpp"
+
+// One entry of a draw list: everything the GL thread needs, copied out of the
+// model, so submitting a list never touches a node or a shape.
+struct DrawItem {
+    uint32_t key;        // sort key, see meshKey()
+    ShapeType type;
+    unsigned int level;
+    glm::mat4 matrix;    // world matrix
+    glm::vec4 color;
+};
+
+struct DrawList {
+    std::vector<DrawItem> items;
+    std::vector<BakedDraw> baked;   // subtrees drawn from the model's bake, not in items
+    uint64_t bake = 0;              // Model::bakeId() the baked entries belong to
+    uint64_t frame = 0;
+};
+
+// Primitive type in the high bits, tessellation level below it, so sorting
+// groups identical meshes next to each other.
+inline uint32_t meshKey(const Shape &s) {
+    return ((uint32_t)s.shapetype << 8) | (s.level & 0xff);
+}
+
+// Traverses the model into a draw list sorted by mesh key. Reuses the list's storage.
+// A subtree the model has baked (inspection mode) becomes one entry of `baked`
+// instead of an item per shape.
+inline void fillDrawList(Model &model, DrawList &list) {
+    list.items.clear();
+    list.baked.clear();
+    model.updateWorld();
+    list.bake = model.bakeId();
+    const FlatHierarchy &h = model.hierarchy();
+    for (size_t i = 0; i < h.size(); i++) {
+        if (model.bakedRoot(i)) {
+            list.baked.push_back(model.bakedDraw(i));
+            i += h.subtreeSize[i] - 1;
+            continue;
+        }
+        const std::shared_ptr<Shape> &s = h.nodes[i]->getShape();
+        if (!s) continue;
+        list.items.push_back({meshKey(*s), s->shapetype, s->level, h.world[i], glm::vec4(s->getColor(), 1.0f)});
+    }
+    std::sort(list.items.begin(), list.items.end(), [](const DrawItem &a, const DrawItem &b) { return a.key < b.key; });
+}
+
+// Frame pipeline: a worker thread traverses the model for frame N+1 while the
+// GL thread submits the draw list of frame N. The two lists are swapped once per
+// frame; their storage is reused so steady-state frames do not allocate.
+//
+// The worker reads the scene, so edits must happen while it is idle; the GL
+// thread only reads the list it was handed (see main.cpp):
+//
+//     pipeline.waitIdle();
+//     glfwPollEvents();                  // key handlers may edit the model here
+//     meshes.submit(pipeline.next(), program, viewProjection);
+//
+class FramePipeline {
+public:
+    explicit FramePipeline(Model &m) : model(m) {
+        worker = std::thread([this] { workerLoop(); });
+    }
+
+    ~FramePipeline() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        cv.notify_all();
+        worker.join();
+    }
+
+    FramePipeline(const FramePipeline&) = delete;
+    FramePipeline& operator=(const FramePipeline&) = delete;
+
+    // Blocks until the worker has finished the traversal it is working on.
+    void waitIdle() {
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [this] { return !traversalRequested; });
+    }
+
+    // Hands out the list traversed last and starts traversing the next frame.
+    // The returned list stays valid until the following call to next(); the
+    // worker never touches it, so the caller may cull it in place.
+    DrawList& next() {
+        waitIdle();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            std::swap(front, back);
+            back->frame = front->frame + 1;
+            traversalRequested = true;
+        }
+        cv.notify_all();
+        return *front;
+    }
+
+private:
+    Model &model;
+    DrawList lists[2];
+    DrawList *front = &lists[0];
+    DrawList *back = &lists[1];
+
+    std::thread worker;
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool traversalRequested = true; // the first frame is traversed right away
+    bool stopping = false;
+
+    void workerLoop() {
+        while (true) {
+            DrawList *target;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                cv.wait(lock, [this] { return traversalRequested || stopping; });
+                if (stopping) return;
+                target = back;
+            }
+            fillDrawList(model, *target);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                traversalRequested = false;
+            }
+            cv.notify_all();
+        }
+    }
+};
@@ -0,0 +1,310 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <png.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "mesh_buffer.cpp"
+#include "procedural_mesh.cpp"
+#include "sphere_impostor.cpp"
+#include "shader_util.cpp"
+#include "lazy_model.cpp"
+#include "occlusion.cpp"
+
+// --- Headless rendering ---
+// Renders .mod files into an offscreen framebuffer without a window, on any
+// EGL implementation including Mesa's surfaceless platform (llvmpipe on
+// machines without a GPU), and writes one PNG per model and camera view.
+//
+//   modeller --headless [--size WxH] [--views front,iso,...] [--out DIR] [--budget MB] [--occlusion] [--procedural] [--impostors] a.mod b.mod ...
+//
+// With --budget, models are opened lazily (see LazyModel) and each view shows
+// the visible pages that fit in the budget, nearest first. --occlusion drops
+// shapes hidden behind the largest ones before submission (see OcclusionCuller).
+// --procedural generates the primitives in the vertex shader instead of
+// uploading meshes (see ProceduralRenderer). --impostors draws spheres that are
+// small on screen as ray-cast quads (see SphereImpostors).
+
+struct HeadlessOptions {
+    int width = 512;
+    int height = 512;
+    std::vector<std::string> views = {"iso"};
+    std::string outDir = ".";
+    uint64_t budgetMB = 0;       // 0: load models whole
+    bool occlusion = false;
+    bool procedural = false;
+    bool impostors = false;
+    std::vector<std::string> models;
+};
+
+class OffscreenContext {
+public:
+    ~OffscreenContext() { destroy(); }
+
+    bool create(int w, int h) {
+        width = w; height = h;
+        auto getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+        if (getPlatformDisplay) display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+        if (display == EGL_NO_DISPLAY) display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+        EGLint major, minor;
+        if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor)) {
+            std::cerr << "Failed to initialize EGL\n";
+            return false;
+        }
+        eglBindAPI(EGL_OPENGL_API);
+
+        EGLint configAttribs[] = { EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE };
+        EGLConfig config = nullptr;
+        EGLint count = 0;
+        eglChooseConfig(display, configAttribs, &config, 1, &count);
+        if (count == 0) config = nullptr; // EGL_KHR_no_config_context
+
+        EGLint contextAttribs[] = {
+            EGL_CONTEXT_MAJOR_VERSION, 3, EGL_CONTEXT_MINOR_VERSION, 3,
+            EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+            EGL_NONE
+        };
+        context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttribs);
+        if (context == EGL_NO_CONTEXT || !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) {
+            std::cerr << "Failed to create a surfaceless OpenGL 3.3 context\n";
+            return false;
+        }
+        if (!gladLoadGLLoader((GLADloadproc)eglGetProcAddress)) {
+            std::cerr << "Failed to initialize GLAD\n";
+            return false;
+        }
+
+        glGenFramebuffers(1, &fbo);
+        glGenRenderbuffers(2, renderbuffers);
+        glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[0]);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+        glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[1]);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, renderbuffers[0]);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, renderbuffers[1]);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+            std::cerr << "Offscreen framebuffer is incomplete\n";
+            return false;
+        }
+        glViewport(0, 0, width, height);
+        std::cout << "Headless renderer: " << glGetString(GL_RENDERER) << "\n";
+        return true;
+    }
+
+    void destroy() {
+        if (display == EGL_NO_DISPLAY) return;
+        if (context != EGL_NO_CONTEXT) {
+            if (fbo) glDeleteFramebuffers(1, &fbo);
+            if (renderbuffers[0]) glDeleteRenderbuffers(2, renderbuffers);
+            eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+            eglDestroyContext(display, context);
+        }
+        eglTerminate(display);
+        display = EGL_NO_DISPLAY;
+        context = EGL_NO_CONTEXT;
+        fbo = 0;
+        renderbuffers[0] = renderbuffers[1] = 0;
+    }
+
+    // Rows come back bottom-up, which writePng() accounts for.
+    void readPixels(std::vector<unsigned char> &rgba) {
+        rgba.resize((size_t)width * height * 4);
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, rgba.data());
+    }
+
+    int width = 0, height = 0;
+
+private:
+    EGLDisplay display = EGL_NO_DISPLAY;
+    EGLContext context = EGL_NO_CONTEXT;
+    GLuint fbo = 0;
+    GLuint renderbuffers[2] = {0, 0};
+};
+
+inline bool writePng(const std::string &path, int width, int height, const std::vector<unsigned char> &bottomUpRgba) {
+    png_image image;
+    std::memset(&image, 0, sizeof(image));
+    image.version = PNG_IMAGE_VERSION;
+    image.width = width;
+    image.height = height;
+    image.format = PNG_FORMAT_RGBA;
+    // negative stride: libpng walks the rows from the bottom up
+    if (!png_image_write_to_file(&image, path.c_str(), 0, bottomUpRgba.data(), -width * 4, nullptr)) {
+        std::cerr << "Cannot write " << path << ": " << image.message << "\n";
+        return false;
+    }
+    return true;
+}
+
+// Camera direction (from the model towards the eye) and up vector of a named view.
+inline bool viewDirection(const std::string &name, glm::vec3 &dir, glm::vec3 &up) {
+    up = glm::vec3(0.0f, 1.0f, 0.0f);
+    if (name == "front") dir = glm::vec3(0, 0, 1);
+    else if (name == "back") dir = glm::vec3(0, 0, -1);
+    else if (name == "left") dir = glm::vec3(-1, 0, 0);
+    else if (name == "right") dir = glm::vec3(1, 0, 0);
+    else if (name == "top") { dir = glm::vec3(0, 1, 0); up = glm::vec3(0, 0, -1); }
+    else if (name == "bottom") { dir = glm::vec3(0, -1, 0); up = glm::vec3(0, 0, 1); }
+    else if (name == "iso") dir = glm::normalize(glm::vec3(1, 1, 1));
+    else return false;
+    return true;
+}
+
+// Projection * view that fits the whole bounding sphere of `bounds` into the frame.
+inline glm::mat4 framingMatrix(const AABB &bounds, const glm::vec3 &dir, const glm::vec3 &up, float aspect) {
+    const float fov = glm::radians(45.0f);
+    glm::vec3 centre = bounds.empty() ? glm::vec3(0.0f) : bounds.center();
+    float radius = bounds.empty() ? 1.0f : std::max(glm::length(bounds.extent()), 1e-3f);
+    float distance = radius / std::sin(0.5f * fov * std::min(aspect, 1.0f)) * 1.05f;
+    glm::mat4 view = glm::lookAt(centre + dir * distance, centre, up);
+    glm::mat4 projection = glm::perspective(fov, aspect, std::max(distance - radius * 1.5f, distance * 1e-3f), distance + radius * 1.5f);
+    return projection * view;
+}
+
+inline bool parseHeadlessOptions(int argc, char **argv, HeadlessOptions &opt) {
+    for (int i = 0; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--size" && i + 1 < argc) {
+            char x;
+            std::istringstream ss(argv[++i]);
+            if (!(ss >> opt.width >> x >> opt.height) || x != 'x' || opt.width <= 0 || opt.height <= 0) {
+                std::cerr << "Invalid --size, expected WxH\n";
+                return false;
+            }
+        } else if (arg == "--views" && i + 1 < argc) {
+            opt.views.clear();
+            std::istringstream ss(argv[++i]);
+            std::string v;
+            while (std::getline(ss, v, ',')) if (!v.empty()) opt.views.push_back(v);
+        } else if (arg == "--out" && i + 1 < argc) {
+            opt.outDir = argv[++i];
+        } else if (arg == "--budget" && i + 1 < argc) {
+            std::istringstream ss(argv[++i]);
+            if (!(ss >> opt.budgetMB) || opt.budgetMB == 0) { std::cerr << "Invalid --budget, expected megabytes\n"; return false; }
+        } else if (arg == "--occlusion") {
+            opt.occlusion = true;
+        } else if (arg == "--procedural") {
+            opt.procedural = true;
+        } else if (arg == "--impostors") {
+            opt.impostors = true;
+        } else if (arg.rfind("--", 0) == 0) {
+            std::cerr << "Unknown option " << arg << "\n";
+            return false;
+        } else {
+            opt.models.push_back(arg);
+        }
+    }
+    glm::vec3 d, u;
+    for (auto &v : opt.views)
+        if (!viewDirection(v, d, u)) { std::cerr << "Unknown view " << v << " (front, back, left, right, top, bottom, iso)\n"; return false; }
+    if (opt.models.empty()) { std::cerr << "No .mod files given\n"; return false; }
+    return true;
+}
+
+inline std::string fileStem(const std::string &path) {
+    size_t slash = path.find_last_of("/\\");
+    std::string name = slash == std::string::npos ? path : path.substr(slash + 1);
+    size_t dot = name.find_last_of('.');
+    return dot == std::string::npos ? name : name.substr(0, dot);
+}
+
+// Entry point for --headless. Returns the process exit code.
+inline int runHeadless(int argc, char **argv) {
+    HeadlessOptions opt;
+    if (!parseHeadlessOptions(argc, argv, opt)) return 2;
+
+    OffscreenContext ctx;
+    if (!ctx.create(opt.width, opt.height)) return 1;
+    GLuint program = loadShaderProgram(opt.procedural ? "shaders/procedural_vshader.glsl" : "shaders/vshader.glsl", "shaders/fshader.glsl");
+    if (!program) return 1;
+    GLuint impostorProgram = opt.impostors ? loadShaderProgram("shaders/impostor_vshader.glsl", "shaders/impostor_fshader.glsl") : 0;
+    if (opt.impostors && !impostorProgram) return 1;
+    glEnable(GL_DEPTH_TEST);
+
+    MeshBuffer meshes;
+    meshes.waitForMeshes = true;   // snapshots show every shape at its own level
+    if (!opt.procedural) meshes.preloadAll();
+    ProceduralRenderer procedural;
+    SphereImpostors impostors;
+    DrawList list;
+    OcclusionCuller culler;
+    std::vector<unsigned char> pixels;
+    float aspect = float(opt.width) / opt.height;
+    int failures = 0;
+
+    for (auto &path : opt.models) {
+        auto start = std::chrono::steady_clock::now();
+        LazyModel lazy;
+        Model eager;
+        Model &model = opt.budgetMB ? lazy.model : eager;
+        AABB bounds;
+        if (opt.budgetMB) {
+            LazyModel::Options lo;
+            lo.budgetBytes = opt.budgetMB << 20;
+            std::string error;
+            if (!lazy.open(path, error, lo)) { std::cerr << "Skipping " << error << "\n"; failures++; continue; }
+            bounds = lazy.bounds();
+        } else {
+            model.load(path);
+            fillDrawList(model, list);
+            bounds = model.bounds().box();
+        }
+        if (!model.root) { std::cerr << "Skipping " << path << ": no nodes\n"; failures++; continue; }
+
+        size_t shapes = list.items.size(), culled = 0, impostorCount = 0;
+        for (auto &v : opt.views) {
+            glm::vec3 dir, up;
+            viewDirection(v, dir, up);
+            glm::mat4 viewProjection = framingMatrix(bounds, dir, up, aspect);
+            if (opt.budgetMB) {
+                // page in what this view shows, as far as the budget allows
+                while (lazy.update(viewProjection) > 0) lazy.finishLoads();
+                fillDrawList(model, list);
+            } else if (opt.occlusion || opt.impostors) {
+                fillDrawList(model, list);   // the previous view took items out of it
+            }
+            shapes = list.items.size();
+            if (opt.occlusion) {
+                culler.cull(list, viewProjection, aspect);
+                culled += culler.culled;
+            }
+            if (opt.impostors) {
+                impostors.take(list, viewProjection, opt.width, opt.height);
+                impostorCount += impostors.drawn;
+            }
+            glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            glUseProgram(program);
+            if (opt.procedural) procedural.submit(list, program, viewProjection);
+            else meshes.submit(list, program, viewProjection);
+            if (opt.impostors) {
+                glUseProgram(impostorProgram);
+                impostors.submit(impostorProgram);
+            }
+            ctx.readPixels(pixels);
+            std::string out = opt.outDir + "/" + fileStem(path) + "_" + v + ".png";
+            if (!writePng(out, opt.width, opt.height, pixels)) failures++;
+        }
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        std::cout << path << ": " << shapes << " shapes, " << opt.views.size() << " view(s), ";
+        if (opt.occlusion) std::cout << culled << " occluded, ";
+        if (opt.impostors) std::cout << impostorCount << " impostors, ";
+        std::cout << ms << " ms\n";
+    }
+
+    glDeleteProgram(program);
+    if (impostorProgram) glDeleteProgram(impostorProgram);
+    return failures ? 1 : 0;
+}
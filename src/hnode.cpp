@@ -1,5 +1,9 @@
+#pragma once
+
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <atomic>
+#include <cstdint>
 #include <vector>
 #include <memory>
 #include <iostream>
@@ -7,7 +11,7 @@
 // Forward declare Shape if not included yet
 class Shape;
 
-class HNode {
+class HNode : public std::enable_shared_from_this<HNode> {
 public:
     HNode(std::shared_ptr<Shape> s = nullptr)
         : shape(s), translation(0.0f), rotation(0.0f), scale(1.0f)
@@ -17,10 +21,55 @@ public:
         children.push_back(child);
     }
 
+    // Structural edits at a position in the child list (see EditHistory).
+    void insertChild(size_t index, std::shared_ptr<HNode> child) {
+        children.insert(children.begin() + index, std::move(child));
+    }
+    std::shared_ptr<HNode> removeChild(size_t index) {
+        std::shared_ptr<HNode> child = std::move(children[index]);
+        children.erase(children.begin() + index);
+        return child;
+    }
+
     void setTranslation(const glm::vec3& t) { translation = t; updateModel(); }
     void setRotation(const glm::vec3& r) { rotation = r; updateModel(); }
     void setScale(const glm::vec3& s) { scale = s; updateModel(); }
 
+    // All three at once. With notify false the generation is left alone, so
+    // many nodes can be set from several threads and followed by a single
+    // transformsChanged().
+    void setTransform(const glm::vec3& t, const glm::vec3& r, const glm::vec3& s, bool notify = true) {
+        translation = t; rotation = r; scale = s;
+        updateModel(notify);
+    }
+    static void transformsChanged() { generation.fetch_add(1, std::memory_order_relaxed); }
+
+    const std::shared_ptr<Shape>& getShape() const { return shape; }
+    // Replacing a shape bumps shapeGeneration(): a flattened hierarchy keeps
+    // raw pointers to the shapes, and this tells it they must be read again.
+    void setShape(std::shared_ptr<Shape> s) {
+        shape = std::move(s);
+        shapes.fetch_add(1, std::memory_order_relaxed);
+    }
+    static uint64_t shapeGeneration() { return shapes.load(std::memory_order_relaxed); }
+    const std::vector<std::shared_ptr<HNode>>& getChildren() const { return children; }
+    const glm::mat4& getLocalMatrix() const { return model; }
+    const glm::vec3& getTranslation() const { return translation; }
+    const glm::vec3& getRotation() const { return rotation; }
+    const glm::vec3& getScale() const { return scale; }
+
+    // Bumped by every transform change on any node, so cached world matrices
+    // can tell they are current without walking the tree.
+    static uint64_t transformGeneration() { return generation.load(std::memory_order_relaxed); }
+
+    // An instance node draws a shared definition subtree under its own transform
+    void setInstance(std::shared_ptr<HNode> definition) { instance = std::move(definition); }
+    const std::shared_ptr<HNode>& getInstance() const { return instance; }
+
+    // Static subtrees are baked into one buffer in inspection mode
+    void setStatic(bool s) { staticSubtree = s; }
+    bool isStatic() const { return staticSubtree; }
+
     void draw(const glm::mat4& parentTransform = glm::mat4(1.0f)) {
         glm::mat4 globalTransform = parentTransform * model;
         if (shape) {
@@ -30,6 +79,7 @@ public:
         for (auto& c : children) {
             c->draw(globalTransform);
         }
+        if (instance) instance->draw(globalTransform);
     }
 
 private:
@@ -38,10 +88,14 @@ private:
     glm::vec3 rotation; // Euler angles in degrees
     glm::vec3 scale;
     glm::mat4 model = glm::mat4(1.0f);
+    bool staticSubtree = false;
 
     std::vector<std::shared_ptr<HNode>> children;
+    std::shared_ptr<HNode> instance;
+    inline static std::atomic<uint64_t> generation{0};
+    inline static std::atomic<uint64_t> shapes{0};
 
-    void updateModel() {
+    void updateModel(bool notify = true) {
         glm::mat4 m = glm::mat4(1.0f);
         m = glm::translate(m, translation);
         m = glm::rotate(m, glm::radians(rotation.x), glm::vec3(1,0,0));
@@ -49,5 +103,6 @@ private:
         m = glm::rotate(m, glm::radians(rotation.z), glm::vec3(0,0,1));
         m = glm::scale(m, scale);
         model = m;
+        if (notify) transformsChanged();
     }
 };
@@ -0,0 +1,196 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "alloc_counter.cpp"
+
+// --- Input recording and replay ---
+// A session log holds every key event and left click, every line typed at a
+// console prompt and every frame in which camera keys were held, one per line:
+//
+//   # modeller input log v1
+//   0.512300 KEY 49 10 1 0           time, GLFW key, scancode, action, mods
+//   1.100000 FRAME 5                 bitmask of held camera keys (see heldCameraKeys)
+//   1.500000 CLICK 412 300 800 600   cursor x, y and window width, height
+//   2.034000 TEXT 1 0.5 0            a console line, read by the prompt of the key before it
+//
+// The file is plain text, so workloads can also be written or generated by hand.
+// Replaying feeds the events through the same handlers as the window at full
+// speed and times each step.
+
+struct InputEvent {
+    enum Kind { KEY, TEXT, FRAME, CLICK };
+    Kind kind = KEY;
+    double time = 0.0;                                  // seconds since recording started
+    int key = 0, scancode = 0, action = 0, mods = 0;    // KEY
+    unsigned int held = 0;                              // FRAME
+    double x = 0.0, y = 0.0;                            // CLICK
+    int width = 0, height = 0;                          // CLICK
+    std::string text;                                   // TEXT
+};
+
+class InputRecorder {
+public:
+    bool open(const std::string &path) {
+        out.open(path);
+        if (!out) { std::cerr << "Cannot open " << path << " to record input\n"; return false; }
+        out << "# modeller input log v1\n";
+        start = std::chrono::steady_clock::now();
+        return true;
+    }
+
+    bool active() const { return out.is_open(); }
+
+    void key(int key, int scancode, int action, int mods) {
+        if (!active()) return;
+        stamp();
+        out << "KEY " << key << " " << scancode << " " << action << " " << mods << "\n";
+    }
+
+    void text(const std::string &line) {
+        if (!active()) return;
+        stamp();
+        out << "TEXT " << line << "\n";
+        out.flush(); // prompts are rare; keep the log usable if the app is killed
+    }
+
+    void click(double x, double y, int width, int height) {
+        if (!active()) return;
+        stamp();
+        out << "CLICK " << x << " " << y << " " << width << " " << height << "\n";
+    }
+
+    void frame(unsigned int held) {
+        if (!active()) return;
+        stamp();
+        out << "FRAME " << held << "\n";
+    }
+
+private:
+    std::ofstream out;
+    std::chrono::steady_clock::time_point start;
+
+    void stamp() {
+        char t[32];
+        std::snprintf(t, sizeof(t), "%.6f ", std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+        out << t;
+    }
+};
+
+// Lines typed at prompts. Live, they come from std::cin and are recorded;
+// during a replay they come from the TEXT events queued by the replayer.
+class ConsoleInput {
+public:
+    InputRecorder *recorder = nullptr;
+
+    std::string line(const std::string &prompt) {
+        std::cout << prompt << std::flush;
+        if (replaying) {
+            if (scripted.empty()) { std::cerr << "Replay: no recorded input for prompt \"" << prompt << "\"\n"; return ""; }
+            std::string l = scripted.front();
+            scripted.pop_front();
+            return l;
+        }
+        std::string l;
+        // skip the newline a previous `std::cin >>` may have left behind
+        while (std::getline(std::cin, l) && l.find_first_not_of(" \t\r") == std::string::npos) {}
+        if (recorder) recorder->text(l);
+        return l;
+    }
+
+    void beginReplay() { replaying = true; scripted.clear(); }
+    void queue(const std::string &l) { scripted.push_back(l); }
+    size_t unused() const { return scripted.size(); }
+
+private:
+    bool replaying = false;
+    std::deque<std::string> scripted;
+};
+
+inline bool readInputLog(const std::string &path, std::vector<InputEvent> &events, std::string &error) {
+    std::ifstream in(path);
+    if (!in) { error = "cannot open " + path; return false; }
+    std::string line;
+    size_t lineNo = 0;
+    while (std::getline(in, line)) {
+        lineNo++;
+        if (line.empty() || line[0] == '#') continue;
+        std::istringstream iss(line);
+        InputEvent e;
+        std::string kind;
+        iss >> e.time >> kind;
+        bool ok = (bool)iss;
+        if (ok && kind == "KEY") { e.kind = InputEvent::KEY; ok = (bool)(iss >> e.key >> e.scancode >> e.action >> e.mods); }
+        else if (ok && kind == "FRAME") { e.kind = InputEvent::FRAME; ok = (bool)(iss >> e.held); }
+        else if (ok && kind == "CLICK") { e.kind = InputEvent::CLICK; ok = (bool)(iss >> e.x >> e.y >> e.width >> e.height); }
+        else if (ok && kind == "TEXT") {
+            e.kind = InputEvent::TEXT;
+            std::getline(iss, e.text);
+            if (!e.text.empty() && e.text[0] == ' ') e.text.erase(0, 1);
+        }
+        else ok = false;
+        if (!ok) { error = path + ":" + std::to_string(lineNo) + ": malformed event"; return false; }
+        events.push_back(e);
+    }
+    return true;
+}
+
+// Drives onKey(event) / onFrame(held) / onClick(event) and then render() for every
+// KEY, FRAME and CLICK event, as fast as possible, and writes one JSON object per
+// step plus a summary to `report`. TEXT events are queued on `console` before the
+// key that prompts for them. Returns the total replay time in milliseconds.
+template <typename OnKey, typename OnFrame, typename OnClick, typename Render>
+double replayInput(const std::vector<InputEvent> &events, ConsoleInput &console, std::ostream &report,
+                   OnKey onKey, OnFrame onFrame, OnClick onClick, Render render) {
+    using clock = std::chrono::steady_clock;
+    auto ms = [](clock::time_point a, clock::time_point b) { return std::chrono::duration<double, std::milli>(b - a).count(); };
+    static const char *kindNames[] = {"KEY", "TEXT", "FRAME", "CLICK"};
+    console.beginReplay();
+    std::vector<double> stepTimes;
+    double total = 0.0;
+    char buf[256];
+
+    for (size_t i = 0; i < events.size(); i++) {
+        const InputEvent &e = events[i];
+        if (e.kind == InputEvent::TEXT) continue;
+        for (size_t j = i + 1; j < events.size() && events[j].kind == InputEvent::TEXT; j++) console.queue(events[j].text);
+
+        auto t0 = clock::now();
+        if (e.kind == InputEvent::KEY) onKey(e);
+        else if (e.kind == InputEvent::CLICK) onClick(e);
+        else onFrame(e.held);
+        auto t1 = clock::now();
+        alloc::Scope frameAllocs;
+        render();
+        auto t2 = clock::now();
+        uint64_t allocs = frameAllocs.allocations();
+
+        double step = ms(t0, t2);
+        stepTimes.push_back(step);
+        total += step;
+        std::snprintf(buf, sizeof(buf), "{\"step\":%zu,\"t\":%.6f,\"event\":\"%s %d\",\"handle_ms\":%.4f,\"frame_ms\":%.4f",
+                      stepTimes.size(), e.time, kindNames[e.kind],
+                      e.kind == InputEvent::KEY ? e.key : e.kind == InputEvent::FRAME ? (int)e.held : (int)e.x,
+                      ms(t0, t1), ms(t1, t2));
+        report << buf;
+        if (alloc::kCounting) report << ",\"frame_allocs\":" << allocs;   // see alloc_counter.cpp
+        report << "}\n";
+    }
+    if (console.unused()) std::cerr << "Replay: " << console.unused() << " recorded console line(s) were never read\n";
+
+    std::vector<double> sorted = stepTimes;
+    std::sort(sorted.begin(), sorted.end());
+    auto pct = [&](double p) { return sorted.empty() ? 0.0 : sorted[std::min(sorted.size() - 1, (size_t)(p * sorted.size()))]; };
+    std::snprintf(buf, sizeof(buf), "{\"steps\":%zu,\"total_ms\":%.3f,\"p50_ms\":%.4f,\"p95_ms\":%.4f,\"max_ms\":%.4f}\n",
+                  sorted.size(), total, pct(0.50), pct(0.95), sorted.empty() ? 0.0 : sorted.back());
+    report << buf;
+    return total;
+}
@@ -0,0 +1,229 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "bounds.cpp"
+#include "parallel_update.cpp"
+
+// --- Interference detection ---
+// Finds every pair of shapes whose solids overlap. The broad phase is a sweep
+// and prune over world bounds along the axis where the shapes are most spread
+// out; the narrow phase is an exact GJK test on the analytic primitives (not
+// their tessellation), which are all convex and stay convex under any affine
+// world transform, so one test covers every pair of types.
+//
+// Shapes that merely touch (a box resting on another) are not reported: each
+// solid is shrunk by a relative kContactTolerance about an interior point first.
+
+struct InterferenceItem {
+    uint32_t id;          // caller's index, reported back in the pairs
+    ShapeType type;
+    glm::mat4 world;
+    AABB bounds;
+};
+
+// Farthest point of the unit primitive (see unitBounds) in direction d.
+inline glm::vec3 unitSupport(ShapeType type, const glm::vec3 &d) {
+    switch (type) {
+    case ShapeType::SPHERE_SHAPE: {
+        float len = glm::length(d);
+        return len > 0.0f ? d / len : glm::vec3(1.0f, 0.0f, 0.0f);
+    }
+    case ShapeType::BOX_SHAPE:
+        return glm::vec3(d.x >= 0.0f ? 0.5f : -0.5f, d.y >= 0.0f ? 0.5f : -0.5f, d.z >= 0.0f ? 0.5f : -0.5f);
+    case ShapeType::CYLINDER_SHAPE: {
+        float r = std::sqrt(d.x * d.x + d.z * d.z);
+        glm::vec3 rim = r > 0.0f ? glm::vec3(d.x / r, 0.0f, d.z / r) : glm::vec3(1.0f, 0.0f, 0.0f);
+        rim.y = d.y >= 0.0f ? 0.5f : -0.5f;
+        return rim;
+    }
+    case ShapeType::CONE_SHAPE: {
+        float r = std::sqrt(d.x * d.x + d.z * d.z);
+        glm::vec3 rim = r > 0.0f ? glm::vec3(d.x / r, 0.0f, d.z / r) : glm::vec3(1.0f, 0.0f, 0.0f);
+        return d.y > glm::dot(rim, d) ? glm::vec3(0.0f, 1.0f, 0.0f) : rim;
+    }
+    }
+    return glm::vec3(0.0f);
+}
+
+// A primitive under its world transform, as a support function, shrunk by
+// `shrink` (relative) towards the centre of its unit bounds, which lies inside
+// every primitive, the cone included.
+struct ConvexSolid {
+    ShapeType type;
+    glm::mat3 linear;
+    glm::mat3 linearT;
+    glm::vec3 centre;      // unit space
+    glm::vec3 origin;      // centre in world space
+    float scale;
+
+    ConvexSolid(ShapeType type, const glm::mat4 &world, float shrink)
+        : type(type), linear(world), linearT(glm::transpose(linear)), centre(unitBounds(type).center()),
+          origin(world * glm::vec4(centre, 1.0f)), scale(1.0f - shrink) {}
+
+    glm::vec3 support(const glm::vec3 &d) const {
+        return linear * ((unitSupport(type, linearT * d) - centre) * scale) + origin;
+    }
+};
+
+namespace gjk {
+
+// Simplex update for the boolean GJK: keeps the feature of the simplex nearest
+// the origin and points d at the origin from it. Returns true once the simplex
+// encloses the origin. s[0] is always the newest point.
+inline bool line(glm::vec3 *s, int &n, glm::vec3 &d) {
+    glm::vec3 a = s[0], b = s[1], ab = b - a, ao = -a;
+    if (glm::dot(ab, ao) > 0.0f) {
+        d = glm::cross(glm::cross(ab, ao), ab);
+        if (glm::dot(d, d) < 1e-20f) return true;   // origin on the segment
+    } else {
+        n = 1;
+        d = ao;
+    }
+    return false;
+}
+
+inline bool triangle(glm::vec3 *s, int &n, glm::vec3 &d) {
+    glm::vec3 a = s[0], b = s[1], c = s[2];
+    glm::vec3 ab = b - a, ac = c - a, ao = -a, abc = glm::cross(ab, ac);
+    if (glm::dot(glm::cross(abc, ac), ao) > 0.0f) {
+        if (glm::dot(ac, ao) > 0.0f) {
+            s[1] = c; n = 2;
+            d = glm::cross(glm::cross(ac, ao), ac);
+            return glm::dot(d, d) < 1e-20f;
+        }
+        n = 2;
+        return line(s, n, d);
+    }
+    if (glm::dot(glm::cross(ab, abc), ao) > 0.0f) {
+        n = 2;
+        return line(s, n, d);
+    }
+    float side = glm::dot(abc, ao);
+    if (side == 0.0f) return true;                  // origin inside the triangle
+    if (side > 0.0f) d = abc;
+    else { s[1] = c; s[2] = b; d = -abc; }
+    return false;
+}
+
+inline bool tetrahedron(glm::vec3 *s, int &n, glm::vec3 &d) {
+    glm::vec3 a = s[0], b = s[1], c = s[2], e = s[3], ao = -a;
+    glm::vec3 abc = glm::cross(b - a, c - a), ace = glm::cross(c - a, e - a), aeb = glm::cross(e - a, b - a);
+    // the winding from triangle() puts e on the negative side of abc
+    if (glm::dot(abc, ao) > 0.0f) { n = 3; return triangle(s, n, d); }
+    if (glm::dot(ace, ao) > 0.0f) { s[1] = c; s[2] = e; n = 3; return triangle(s, n, d); }
+    if (glm::dot(aeb, ao) > 0.0f) { s[1] = e; s[2] = b; n = 3; return triangle(s, n, d); }
+    return true;
+}
+
+// True if the two solids overlap.
+inline bool intersect(const ConvexSolid &p, const ConvexSolid &q) {
+    auto support = [&](const glm::vec3 &d) { return p.support(d) - q.support(-d); };
+    glm::vec3 d = q.origin - p.origin;
+    if (glm::dot(d, d) < 1e-20f) d = glm::vec3(1.0f, 0.0f, 0.0f);
+    glm::vec3 s[4];
+    int n = 1;
+    s[0] = support(d);
+    d = -s[0];
+    for (int iteration = 0; iteration < 64; iteration++) {
+        if (glm::dot(d, d) < 1e-20f) return true;   // origin on the simplex
+        glm::vec3 a = support(d);
+        if (glm::dot(a, d) < 0.0f) return false;    // a separating direction
+        for (int k = n; k > 0; k--) s[k] = s[k - 1];
+        s[0] = a;
+        n++;
+        bool enclosed = n == 2 ? line(s, n, d) : n == 3 ? triangle(s, n, d) : tetrahedron(s, n, d);
+        if (enclosed) return true;
+    }
+    return true; // no separating direction found: grazing contact, report it
+}
+
+} // namespace gjk
+
+class InterferenceChecker {
+public:
+    static constexpr float kContactTolerance = 1e-4f;
+
+    struct Result {
+        std::vector<std::pair<uint32_t, uint32_t>> pairs;   // ids, smaller first, sorted
+        size_t candidates = 0;                              // pairs whose bounds overlap
+    };
+
+    // Serial when pool is null.
+    explicit InterferenceChecker(WorkStealingPool *pool = &sharedPool(), size_t grain = 1024)
+        : pool(pool), grain(grain) {}
+
+    Result check(const std::vector<InterferenceItem> &items) {
+        // Sweep axis: the one with the widest spread of centres.
+        AABB centres;
+        for (auto &it : items) if (!it.bounds.empty()) centres.expand(it.bounds.center());
+        glm::vec3 spread = centres.max - centres.min;
+        axis = spread.x >= spread.y ? (spread.x >= spread.z ? 0 : 2) : (spread.y >= spread.z ? 1 : 2);
+
+        order.clear();
+        for (uint32_t i = 0; i < items.size(); i++) if (!items[i].bounds.empty()) order.push_back(i);
+        std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+            return items[a].bounds.min[axis] < items[b].bounds.min[axis];
+        });
+
+        // Each chunk of the sorted order sweeps forward on its own and keeps its own results.
+        size_t chunks = (order.size() + grain - 1) / grain;
+        found.assign(chunks, {});
+        tested.assign(chunks, 0);
+        TaskGroup group;
+        for (size_t c = 0; c < chunks; c++) {
+            if (pool) pool->submit(group, [this, &items, c] { sweep(items, c); });
+            else sweep(items, c);
+        }
+        if (pool) pool->wait(group);
+
+        Result r;
+        for (size_t c = 0; c < chunks; c++) {
+            r.pairs.insert(r.pairs.end(), found[c].begin(), found[c].end());
+            r.candidates += tested[c];
+        }
+        std::sort(r.pairs.begin(), r.pairs.end());
+        return r;
+    }
+
+private:
+    WorkStealingPool *pool;
+    size_t grain;
+    int axis = 0;
+    std::vector<uint32_t> order;
+    std::vector<std::vector<std::pair<uint32_t, uint32_t>>> found;
+    std::vector<size_t> tested;
+
+    static bool overlap(const AABB &a, const AABB &b) {
+        return a.min.x <= b.max.x && b.min.x <= a.max.x && a.min.y <= b.max.y && b.min.y <= a.max.y &&
+               a.min.z <= b.max.z && b.min.z <= a.max.z;
+    }
+
+    void sweep(const std::vector<InterferenceItem> &items, size_t chunk) {
+        size_t begin = chunk * grain, end = std::min(order.size(), begin + grain);
+        for (size_t i = begin; i < end; i++) {
+            const InterferenceItem &a = items[order[i]];
+            for (size_t j = i + 1; j < order.size(); j++) {
+                const InterferenceItem &b = items[order[j]];
+                if (b.bounds.min[axis] > a.bounds.max[axis]) break;
+                if (!overlap(a.bounds, b.bounds)) continue;
+                tested[chunk]++;
+                ConvexSolid sa(a.type, a.world, kContactTolerance), sb(b.type, b.world, kContactTolerance);
+                if (gjk::intersect(sa, sb)) found[chunk].push_back(std::minmax(a.id, b.id));
+            }
+        }
+    }
+};
+
+// One item per shape of a flattened hierarchy; ids are FlatHierarchy indices.
+inline std::vector<InterferenceItem> interferenceItems(const FlatHierarchy &h) {
+    std::vector<InterferenceItem> items;
+    for (uint32_t i = 0; i < h.size(); i++)
+        if (h.shapes[i]) items.push_back({i, h.shapes[i]->shapetype, h.world[i], h.bounds[i]});
+    return items;
+}
@@ -0,0 +1,518 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "model.cpp"
+
+// --- Lazy loading ---
+// Large .mod files are opened through a sidecar index (<file>.idx) that splits
+// the tree into pages: runs of sibling subtrees of at most `pageBytes` bytes,
+// each with its byte range, node count and world bounds. Opening parses only
+// the nodes above the pages (the skeleton) and puts a stub node in place of
+// every page. Pages are read on a background thread when their bounds come into
+// view or a stub is expanded, and the least recently visible ones are dropped
+// again when the estimated resident size goes over the budget.
+
+struct PageEntry {
+    uint64_t offset = 0;   // byte offset of the page's first line
+    uint64_t length = 0;   // bytes, up to and including the last subtree's ENDNODE line
+    uint64_t nodes = 0;    // nodes in the page, instances expanded
+    AABB bounds;           // world bounds of everything in the page
+};
+
+// Builds the page table in one streaming pass, keeping only the open nodes in
+// memory. World matrices and bounds follow FlatHierarchy exactly: NODE and
+// INSTANCE lines both get the local matrix of an HNode built from their
+// translate/rotate/scale, and definitions are measured in their own frame.
+class ModelIndexer {
+public:
+    bool build(std::istream &in, uint64_t pageBytes, std::vector<PageEntry> &pages, std::string &error) {
+        pages.clear();
+        struct Frame {
+            uint64_t start;
+            glm::mat4 world;
+            AABB bounds;
+            uint64_t nodes;
+            std::vector<PageEntry> small;   // closed children that fit in a page, in file order
+        };
+        std::vector<Frame> stack;
+        std::map<std::string, std::pair<AABB, uint64_t>> defs;   // bounds and node count per definition
+        std::string defining;
+        PageEntry definitionRoot;
+        bool inDefine = false;
+
+        auto emitRuns = [&](const std::vector<PageEntry> &small) {
+            PageEntry run;
+            for (const PageEntry &c : small) {
+                if (run.length > 0 && c.offset == run.offset + run.length && run.length + c.length <= pageBytes) {
+                    run.length += c.length;
+                    run.nodes += c.nodes;
+                    run.bounds.expand(c.bounds);
+                } else {
+                    if (run.length > 0) pages.push_back(run);
+                    run = c;
+                }
+            }
+            if (run.length > 0) pages.push_back(run);
+        };
+        // A finished child subtree (NODE ... ENDNODE, or one INSTANCE line).
+        auto closeChild = [&](const PageEntry &child) {
+            if (stack.empty()) { if (inDefine) definitionRoot = child; return; }
+            Frame &p = stack.back();
+            p.bounds.expand(child.bounds);
+            p.nodes += child.nodes;
+            if (!inDefine && child.length <= pageBytes) p.small.push_back(child);
+        };
+
+        std::string line, token;
+        uint64_t offset = 0;
+        size_t lineNo = 0;
+        while (std::getline(in, line)) {
+            uint64_t lineStart = offset;
+            offset += line.size() + 1;
+            lineNo++;
+            std::istringstream iss(line);
+            if (!(iss >> token) || token[0] == '#') continue;
+
+            if (token == "NODE") {
+                std::string type;
+                unsigned int level;
+                float v[9];
+                iss >> type >> level;
+                for (float &x : v) iss >> x;
+                if (!iss) { error = std::to_string(lineNo) + ": bad NODE line"; return false; }
+                glm::mat4 world = nodeWorld(stack.empty() ? nullptr : &stack.back().world, v);
+                Frame f{lineStart, world, transformBounds(world, unitBounds(shapeTypeFromName(type))), 1, {}};
+                stack.push_back(std::move(f));
+            } else if (token == "INSTANCE") {
+                std::string name;
+                float v[9];
+                iss >> name;
+                for (float &x : v) iss >> x;
+                auto def = defs.find(name);
+                if (!iss || def == defs.end()) { error = std::to_string(lineNo) + ": bad INSTANCE line"; return false; }
+                glm::mat4 world = nodeWorld(stack.empty() ? nullptr : &stack.back().world, v);
+                PageEntry e;
+                e.offset = lineStart;
+                e.length = offset - lineStart;
+                e.nodes = 1 + def->second.second;
+                e.bounds = transformBounds(world, def->second.first);
+                closeChild(e);
+            } else if (token == "ENDNODE") {
+                if (stack.empty()) { error = std::to_string(lineNo) + ": ENDNODE without NODE"; return false; }
+                Frame f = std::move(stack.back());
+                stack.pop_back();
+                PageEntry e;
+                e.offset = f.start;
+                e.length = offset - f.start;
+                e.nodes = f.nodes;
+                e.bounds = f.bounds;
+                if (e.length > pageBytes) emitRuns(f.small); // too big to be (part of) a page itself
+                closeChild(e);
+            } else if (token == "DEFINE") {
+                iss >> defining;
+                inDefine = true;
+                definitionRoot = PageEntry();
+            } else if (token == "ENDDEFINE") {
+                defs[defining] = {definitionRoot.bounds, definitionRoot.nodes};
+                inDefine = false;
+            }
+        }
+        if (!stack.empty()) { error = "unexpected end of file"; return false; }
+        std::sort(pages.begin(), pages.end(), [](const PageEntry &a, const PageEntry &b) { return a.offset < b.offset; });
+        return true;
+    }
+
+    // World matrix of a node with translate/rotate/scale `v` under `parent`
+    // (nullptr at the top), composed the way HNode does it.
+    static glm::mat4 nodeWorld(const glm::mat4 *parent, const float v[9]) {
+        HNode node;
+        node.setTransform(glm::vec3(v[0], v[1], v[2]), glm::vec3(v[3], v[4], v[5]), glm::vec3(v[6], v[7], v[8]), false);
+        return parent ? *parent * node.getLocalMatrix() : node.getLocalMatrix();
+    }
+
+    static ShapeType shapeTypeFromName(const std::string &name) {
+        if (name == "CYLINDER") return ShapeType::CYLINDER_SHAPE;
+        if (name == "BOX") return ShapeType::BOX_SHAPE;
+        if (name == "CONE") return ShapeType::CONE_SHAPE;
+        return ShapeType::SPHERE_SHAPE;
+    }
+};
+
+// Sidecar file: magic, source size and modification time (so a stale index is
+// rebuilt), page size, page count, then one fixed-size record per page.
+namespace modindex {
+
+// 02: NODE transforms are part of the page bounds; 01 files are rebuilt.
+const char kMagic[8] = {'M','O','D','I','D','X','0','2'};
+
+struct Header {
+    char magic[8];
+    uint64_t sourceSize;
+    int64_t sourceTime;
+    uint64_t pageBytes;
+    uint64_t count;
+};
+
+struct Record {
+    uint64_t offset, length, nodes;
+    float min[3], max[3];
+};
+
+inline bool sourceStamp(const std::string &path, uint64_t &size, int64_t &time) {
+    std::error_code ec;
+    size = std::filesystem::file_size(path, ec);
+    if (ec) return false;
+    time = (int64_t)std::filesystem::last_write_time(path, ec).time_since_epoch().count();
+    return !ec;
+}
+
+inline bool read(const std::string &idxPath, const Header &expect, std::vector<PageEntry> &pages) {
+    std::ifstream in(idxPath, std::ios::binary);
+    Header h;
+    if (!in.read((char*)&h, sizeof(h))) return false;
+    if (std::memcmp(h.magic, kMagic, 8) != 0 || h.sourceSize != expect.sourceSize ||
+        h.sourceTime != expect.sourceTime || h.pageBytes != expect.pageBytes) return false;
+    // a damaged count must not size the allocation; the file says how many records fit
+    std::error_code ec;
+    uint64_t size = std::filesystem::file_size(idxPath, ec);
+    if (ec || size < sizeof(Header) || h.count > (size - sizeof(Header)) / sizeof(Record)) return false;
+    std::vector<Record> records(h.count);
+    if (!in.read((char*)records.data(), records.size() * sizeof(Record))) return false;
+    pages.resize(records.size());
+    for (size_t i = 0; i < records.size(); i++) {
+        const Record &r = records[i];
+        pages[i].offset = r.offset;
+        pages[i].length = r.length;
+        pages[i].nodes = r.nodes;
+        pages[i].bounds.min = glm::vec3(r.min[0], r.min[1], r.min[2]);
+        pages[i].bounds.max = glm::vec3(r.max[0], r.max[1], r.max[2]);
+    }
+    return true;
+}
+
+inline bool write(const std::string &idxPath, Header h, const std::vector<PageEntry> &pages) {
+    std::ofstream out(idxPath, std::ios::binary);
+    std::memcpy(h.magic, kMagic, 8);
+    h.count = pages.size();
+    out.write((const char*)&h, sizeof(h));
+    for (const PageEntry &p : pages) {
+        Record r{p.offset, p.length, p.nodes, {p.bounds.min.x, p.bounds.min.y, p.bounds.min.z},
+                 {p.bounds.max.x, p.bounds.max.y, p.bounds.max.z}};
+        out.write((const char*)&r, sizeof(r));
+    }
+    return (bool)out;
+}
+
+} // namespace modindex
+
+class LazyModel {
+public:
+    struct Options {
+        uint64_t pageBytes = 1 << 20;
+        uint64_t budgetBytes = 1ull << 30;   // estimated memory for resident pages
+        uint64_t bytesPerNode = 512;         // estimate per resident node (HNode, shape, flattened entry)
+        unsigned int maxInFlight = 4;        // pages queued for loading at once
+    };
+
+    Model model;   // skeleton plus resident pages; draw, pick and update through it
+
+    // Cleared while the resident pages may hold edits (the modeller does so
+    // while it has undo history): evicting one would throw its edits away, so
+    // pages then still load within the budget but no longer make room.
+    bool evictPages = true;
+
+    ~LazyModel() { stopLoader(); }
+
+    // Builds the index if there is no valid one next to the file, then reads the skeleton.
+    bool open(const std::string &path, std::string &error) { return open(path, error, Options()); }
+
+    bool open(const std::string &path, std::string &error, const Options &options) {
+        stopLoader();
+        opt = options;
+        source = path;
+        pages.clear();
+        byStub.clear();
+        resident = inFlightBytes = 0;
+
+        modindex::Header h{};
+        h.pageBytes = opt.pageBytes;
+        if (!modindex::sourceStamp(path, h.sourceSize, h.sourceTime)) { error = "cannot open " + path; return false; }
+        sourceSize = h.sourceSize;
+        sourceTime = h.sourceTime;
+        std::vector<PageEntry> entries;
+        std::string idxPath = path + ".idx";
+        if (!modindex::read(idxPath, h, entries)) {
+            std::ifstream in(path, std::ios::binary);
+            if (!ModelIndexer().build(in, opt.pageBytes, entries, error)) { error = path + ":" + error; return false; }
+            if (!modindex::write(idxPath, h, entries)) std::cerr << "Cannot write index " << idxPath << ", continuing without it\n";
+        }
+
+        pages.resize(entries.size());
+        for (size_t i = 0; i < entries.size(); i++) {
+            pages[i].entry = entries[i];
+            pages[i].stub = std::make_shared<HNode>();
+            byStub[pages[i].stub.get()] = i;
+        }
+
+        // Skeleton: the whole file except the page ranges, which become stubs.
+        std::ifstream in(path, std::ios::binary);
+        size_t next = 0;
+        Model::SkipHook skip = [&](uint64_t &offset) -> std::shared_ptr<HNode> {
+            if (next >= pages.size() || pages[next].entry.offset != offset) return nullptr;
+            offset += pages[next].entry.length;
+            return pages[next++].stub;
+        };
+        std::istringstream nothing;
+        model.read(nothing, error); // start from an empty model
+        if (!model.parse(in, error, model.root, nullptr, &skip)) { error = path + ":" + error; return false; }
+        if (next != pages.size()) { error = path + ": index does not match the file, delete " + idxPath; return false; }
+        model.writeHook = [this](const HNode &node, std::ostream &out) { return writePage(node, out); };
+
+        stopping = false;
+        loader = std::thread([this] { loaderLoop(); });
+        return true;
+    }
+
+    // Forgets the file: stops the loader and empties `model`, which can then be
+    // read whole like any other.
+    void close() {
+        stopLoader();
+        pages.clear();
+        byStub.clear();
+        resident = inFlightBytes = 0;
+        model.writeHook = nullptr;
+        std::istringstream nothing;
+        std::string error;
+        model.read(nothing, error);
+    }
+
+    // Call once per frame: attaches finished pages, queues visible ones (nearest
+    // first) and evicts pages that have been out of view longest while over budget.
+    // Returns the number of pages queued.
+    size_t update(const glm::mat4 &viewProjection) {
+        frame++;
+        attachFinished();
+        Frustum frustum(viewProjection);
+        std::vector<std::pair<float, size_t>> wanted;
+        for (size_t i = 0; i < pages.size(); i++) {
+            Page &p = pages[i];
+            if (!frustum.intersects(p.entry.bounds)) continue;
+            p.lastUsed = frame;
+            if (p.state == Page::OUT) wanted.push_back({(viewProjection * glm::vec4(p.entry.bounds.center(), 1.0f)).w, i});
+        }
+        std::sort(wanted.begin(), wanted.end());
+        size_t queued = 0;
+        for (auto &w : wanted) {
+            if (!request(w.second)) break;
+            queued++;
+        }
+        return queued;
+    }
+
+    // Loads the page behind a stub node (e.g. one the user expanded) regardless of visibility.
+    bool expand(const HNode *stub) {
+        auto it = byStub.find(stub);
+        if (it == byStub.end()) return false;
+        pages[it->second].lastUsed = frame;
+        return request(it->second);
+    }
+
+    // Blocks until every queued page is loaded, then attaches them.
+    void finishLoads() {
+        std::unique_lock<std::mutex> lock(m);
+        idle.wait(lock, [&] { return queue.empty() && busy == 0; });
+        lock.unlock();
+        attachFinished();
+    }
+
+    size_t pageCount() const { return pages.size(); }
+    uint64_t residentBytes() const { return resident; }
+    size_t residentPages() const {
+        size_t n = 0;
+        for (auto &p : pages) n += p.state == Page::IN;
+        return n;
+    }
+
+    // Bounds of the whole model, resident or not.
+    AABB bounds() {
+        model.updateWorld();
+        AABB b = model.bounds().box();
+        for (auto &p : pages) b.expand(p.entry.bounds);
+        return b;
+    }
+
+private:
+    struct Page {
+        enum State { OUT, LOADING, IN };
+        PageEntry entry;
+        std::shared_ptr<HNode> stub;
+        State state = OUT;
+        uint64_t lastUsed = 0;
+    };
+    struct Loaded { size_t page; std::shared_ptr<HNode> group; std::string error; };
+
+    Options opt;
+    std::string source;
+    uint64_t sourceSize = 0;     // stamp of the source when it was opened
+    int64_t sourceTime = 0;
+    std::vector<Page> pages;
+    std::unordered_map<const HNode*, size_t> byStub;
+    uint64_t frame = 0;
+    uint64_t resident = 0, inFlightBytes = 0;
+
+    std::thread loader;
+    std::mutex m;
+    std::condition_variable wake, idle;
+    std::deque<size_t> queue;
+    std::vector<Loaded> finished;
+    size_t busy = 0;
+    bool stopping = false;
+
+    uint64_t estimate(const Page &p) const { return p.entry.nodes * opt.bytesPerNode; }
+
+    // Model::writeHook: a page that is not loaded is copied from the source file
+    // as it is, which needs the file to be the one the page table describes.
+    // Loaded pages are written from memory, edits included.
+    Model::WriteResult writePage(const HNode &node, std::ostream &out) const {
+        auto it = byStub.find(&node);
+        if (it == byStub.end() || pages[it->second].state == Page::IN) return Model::WriteResult::NOT_HANDLED;
+        const PageEntry &e = pages[it->second].entry;
+        uint64_t size;
+        int64_t time;
+        if (!modindex::sourceStamp(source, size, time) || size != sourceSize || time != sourceTime) {
+            std::cerr << source << " changed since it was opened; its unloaded pages cannot be saved\n";
+            return Model::WriteResult::FAILED;
+        }
+        std::ifstream in(source, std::ios::binary);
+        in.seekg((std::streamoff)e.offset);
+        char buffer[1 << 16];
+        for (uint64_t left = e.length; left > 0;) {
+            std::streamsize n = (std::streamsize)std::min<uint64_t>(left, sizeof(buffer));
+            if (!in.read(buffer, n)) return Model::WriteResult::FAILED;
+            out.write(buffer, n);
+            left -= (uint64_t)n;
+        }
+        return out ? Model::WriteResult::WRITTEN : Model::WriteResult::FAILED;
+    }
+
+    // Queues a page if the budget allows it, evicting cold pages to make room.
+    bool request(size_t i) {
+        Page &p = pages[i];
+        if (p.state != Page::OUT) return true;
+        {
+            std::lock_guard<std::mutex> lock(m);
+            if (queue.size() + busy >= opt.maxInFlight) return false;
+        }
+        uint64_t need = estimate(p);
+        while (resident + inFlightBytes + need > opt.budgetBytes) {
+            if (!evictColdest()) return false;
+        }
+        p.state = Page::LOADING;
+        inFlightBytes += need;
+        {
+            std::lock_guard<std::mutex> lock(m);
+            queue.push_back(i);
+        }
+        wake.notify_one();
+        return true;
+    }
+
+    // Drops the resident page seen longest ago, unless it was seen this frame.
+    bool evictColdest() {
+        if (!evictPages) return false;
+        Page *coldest = nullptr;
+        for (auto &p : pages)
+            if (p.state == Page::IN && p.lastUsed < frame && (!coldest || p.lastUsed < coldest->lastUsed)) coldest = &p;
+        if (!coldest) return false;
+        coldest->stub->setInstance(nullptr);
+        coldest->state = Page::OUT;
+        resident -= estimate(*coldest);
+        model.invalidateHierarchy();
+        return true;
+    }
+
+    void attachFinished() {
+        std::vector<Loaded> done;
+        {
+            std::lock_guard<std::mutex> lock(m);
+            done.swap(finished);
+        }
+        for (auto &d : done) {
+            Page &p = pages[d.page];
+            inFlightBytes -= estimate(p);
+            if (!d.group) {
+                std::cerr << source << ": page at byte " << p.entry.offset << ":" << d.error << "\n";
+                p.state = Page::OUT;
+                continue;
+            }
+            p.stub->setInstance(d.group);
+            p.state = Page::IN;
+            resident += estimate(p);
+        }
+        if (!done.empty()) model.invalidateHierarchy();
+    }
+
+    void loaderLoop() {
+        std::ifstream in(source, std::ios::binary);
+        std::string buffer;
+        while (true) {
+            size_t i;
+            {
+                std::unique_lock<std::mutex> lock(m);
+                wake.wait(lock, [&] { return stopping || !queue.empty(); });
+                if (stopping) return;
+                i = queue.front();
+                queue.pop_front();
+                busy++;
+            }
+            const PageEntry &e = pages[i].entry;
+            Loaded result{i, nullptr, ""};
+            buffer.resize(e.length);
+            in.clear();
+            in.seekg((std::streamoff)e.offset);
+            if (in.read(&buffer[0], (std::streamsize)e.length)) {
+                std::istringstream ss(buffer);
+                auto group = std::make_shared<HNode>();
+                std::shared_ptr<HNode> unused;
+                if (model.parse(ss, result.error, unused, group.get())) result.group = group;
+            } else {
+                result.error = " read failed";
+            }
+            {
+                std::lock_guard<std::mutex> lock(m);
+                finished.push_back(std::move(result));
+                busy--;
+            }
+            idle.notify_all();
+        }
+    }
+
+    void stopLoader() {
+        if (!loader.joinable()) return;
+        {
+            std::lock_guard<std::mutex> lock(m);
+            stopping = true;
+            queue.clear();
+        }
+        wake.notify_all();
+        loader.join();
+        finished.clear();
+        busy = 0;
+    }
+};
@@ -4,6 +4,8 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include <algorithm>
+#include <filesystem>
 #include <iostream>
 #include <vector>
 #include <memory>
@@ -15,6 +17,16 @@
 #include "cylinder.cpp"
 #include "box.cpp"
 #include "cone.cpp"
+#include "unit_mesh.cpp"
+#include "headless.cpp"
+#include "batch_cli.cpp"
+#include "input_replay.cpp"
+#include "picking.cpp"
+#include "interference.cpp"
+#include "undo_history.cpp"
+#include "model_bounds.cpp"
+#include "selection.cpp"
+#include "occlusion.cpp"
 
 enum Mode { MODE_MODELLING, MODE_INSPECTION };
 enum TransformMode { NONE, ROTATE, TRANSLATE, SCALE };
@@ -23,9 +35,24 @@ Mode currentMode = MODE_MODELLING;
 TransformMode activeTransform = NONE;
 char activeAxis = 'X';
 
-std::vector<std::shared_ptr<Shape>> shapes;
-std::shared_ptr<Shape> currentShape = nullptr;
-int currentShapeIndex = -1;
+// The scene is a Model whose root is a grouping node; each added part is a
+// child of it. Nodes are numbered in the flattened hierarchy's order in
+// messages ("shape N"), so the first part is shape 1. It is the model of a
+// LazyModel, which only pages when a large file was opened (see loadModel).
+LazyModel lazy;
+Model &scene = lazy.model;
+std::shared_ptr<HNode> currentNode;   // the selected node, always one with a shape
+int currentIndex = -1;                // its index in scene.hierarchy() when it was selected
+EditHistory history(scene);           // every edit goes through it, so it can be undone
+SelectionSets selectionSets;
+std::string activeSet;                // transforms apply to this named set; empty: the current shape
+
+// O toggles occlusion culling of the frame's draw list (see OcclusionCuller),
+// P drawing small spheres as ray-cast quads (see SphereImpostors)
+bool occlusionCulling = false;
+OcclusionCuller culler;
+bool sphereImpostors = false;
+int viewportWidth = 800, viewportHeight = 600;   // impostors are chosen by their size in pixels
 
 // Camera globals
 glm::vec3 camPos(0.0f, 0.0f, 5.0f);
@@ -38,28 +65,41 @@ float sensitivity = 2.5f;
 glm::mat4 view;
 glm::mat4 projection;
 
+// Input goes through handleKey()/moveCamera()/console so it can be recorded and replayed
+bool quitRequested = false;
+InputRecorder recorder;
+ConsoleInput console;
+
 // Callbacks
 void framebuffer_size_callback(GLFWwindow* window, int width, int height) {
     glViewport(0, 0, width, height);
+    viewportWidth = width;
+    viewportHeight = height;
+}
+
+// Camera keys held this frame, one bit each: W S A D Up Down Left Right
+const int cameraKeys[] = { GLFW_KEY_W, GLFW_KEY_S, GLFW_KEY_A, GLFW_KEY_D, GLFW_KEY_UP, GLFW_KEY_DOWN, GLFW_KEY_LEFT, GLFW_KEY_RIGHT };
+
+unsigned int heldCameraKeys(GLFWwindow* window) {
+    unsigned int held = 0;
+    for (int i = 0; i < 8; i++)
+        if (glfwGetKey(window, cameraKeys[i]) == GLFW_PRESS) held |= 1u << i;
+    return held;
 }
 
 // Camera movement
-void moveCamera(GLFWwindow* window) {
+void moveCamera(unsigned int held) {
     glm::vec3 right = glm::normalize(glm::cross(camFront, camUp));
-    if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
-        camPos += cameraSpeed * camFront;
-    if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
-        camPos -= cameraSpeed * camFront;
-    if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
-        camPos -= cameraSpeed * right;
-    if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
-        camPos += cameraSpeed * right;
+    if (held & 1) camPos += cameraSpeed * camFront;
+    if (held & 2) camPos -= cameraSpeed * camFront;
+    if (held & 4) camPos -= cameraSpeed * right;
+    if (held & 8) camPos += cameraSpeed * right;
 
     // Arrow keys for yaw/pitch
-    if (glfwGetKey(window, GLFW_KEY_UP) == GLFW_PRESS) pitch += sensitivity * 0.1f;
-    if (glfwGetKey(window, GLFW_KEY_DOWN) == GLFW_PRESS) pitch -= sensitivity * 0.1f;
-    if (glfwGetKey(window, GLFW_KEY_LEFT) == GLFW_PRESS) yaw -= sensitivity * 0.5f;
-    if (glfwGetKey(window, GLFW_KEY_RIGHT) == GLFW_PRESS) yaw += sensitivity * 0.5f;
+    if (held & 16) pitch += sensitivity * 0.1f;
+    if (held & 32) pitch -= sensitivity * 0.1f;
+    if (held & 64) yaw -= sensitivity * 0.5f;
+    if (held & 128) yaw += sensitivity * 0.5f;
 
     if (pitch > 89.0f) pitch = 89.0f;
     if (pitch < -89.0f) pitch = -89.0f;
@@ -73,64 +113,266 @@ void moveCamera(GLFWwindow* window) {
     view = glm::lookAt(camPos, camPos + camFront, camUp);
 }
 
+// Looks at the centroid of all shapes from the front, backed off until their
+// bounds fit in view. A lazily opened model is framed on the bounds of all its
+// pages, loaded or not.
+void frameShapes() {
+    AABB box;
+    glm::vec3 centre;
+    if (lazy.pageCount()) {
+        box = lazy.bounds();
+        if (box.empty()) return;
+        centre = box.center();
+    } else {
+        const ModelBounds &bounds = scene.bounds();
+        if (!bounds.shapeCount()) return;
+        centre = bounds.centroid();
+        box = bounds.box();
+    }
+    float radius = std::max(glm::length(glm::max(glm::abs(box.min - centre), glm::abs(box.max - centre))), 1e-3f);
+    float distance = radius / std::sin(glm::radians(22.5f)) * 1.05f;
+    yaw = -90.0f; pitch = 0.0f;
+    camPos = centre + glm::vec3(0.0f, 0.0f, distance);
+    projection = glm::perspective(glm::radians(45.0f), 800.0f/600.0f, 0.1f, std::max(100.0f, distance + 2.0f * radius));
+    moveCamera(0);
+}
+
+// Makes node `i` of the flattened scene the current one.
+void selectNode(int i) {
+    currentIndex = i;
+    currentNode = i < 0 ? nullptr : scene.hierarchy().nodes[i]->shared_from_this();
+}
+
+// Index of `node` in the flattened scene, -1 if it is no longer in it.
+int nodeIndex(const HNode *node) {
+    scene.updateWorld();
+    const std::vector<HNode*> &nodes = scene.hierarchy().nodes;
+    auto it = std::find(nodes.begin(), nodes.end(), node);
+    return it == nodes.end() ? -1 : (int)(it - nodes.begin());
+}
+
+// Keeps the selection valid after the tree changed under it (undo, redo,
+// removal): if the current node is gone, the shape now at or after its old
+// place is selected instead, or failing that the last one.
+void reselect() {
+    scene.updateWorld();
+    const FlatHierarchy &h = scene.hierarchy();
+    // still in place: keep the occurrence, which for an instanced node may not be the first
+    if (currentNode && currentIndex >= 0 && currentIndex < (int)h.size() && h.nodes[currentIndex] == currentNode.get()) return;
+    int i = currentNode ? nodeIndex(currentNode.get()) : -1;
+    if (i >= 0) { currentIndex = i; return; }
+    int pick = -1;
+    for (int k = 0; k < (int)h.size(); k++) {
+        if (!h.shapes[k]) continue;
+        pick = k;
+        if (k >= currentIndex) break;
+    }
+    selectNode(pick);
+}
+
+// A shapeless grouping root for the parts to be added to; a loaded model
+// with a single root node becomes its first part.
+void ensureGroupRoot() {
+    if (scene.root && !scene.root->getShape() && !scene.root->getInstance()) return;
+    std::shared_ptr<HNode> group = std::make_shared<HNode>();
+    if (scene.root) group->addChild(scene.root);
+    scene.root = group;
+    scene.invalidateHierarchy();
+}
+
 // Save model
 void saveModel(const std::string& filename) {
-    std::ofstream out(filename);
-    if (!out) { std::cerr << "Cannot open file to write.\n"; return; }
-    for (auto& s : shapes) out << s->serialize() << "\n";
-    std::cout << "Model saved to " << filename << "\n";
+    scene.save(filename);
 }
 
+// Files from this size on are opened lazily: the top of the hierarchy shows at
+// once and its pages load as they come into view (see LazyModel).
+const uintmax_t kLazyOpenBytes = 256ull << 20;
+
 // Load model
 void loadModel(const std::string& filename) {
-    std::ifstream in(filename);
-    if (!in) { std::cerr << "Cannot open file to read.\n"; return; }
-
-    shapes.clear();
-    currentShape = nullptr;
-    currentShapeIndex = -1;
-
-    std::string line;
-    while (std::getline(in, line)) {
-        std::istringstream iss(line);
-        std::string type;
-        iss >> type;
-
-        if (type == "SPHERE") shapes.push_back(std::make_shared<Sphere>(1.0f, 1));
-        else if (type == "CYLINDER") shapes.push_back(std::make_shared<Cylinder>(1.0f, 1.0f, 1));
-        else if (type == "BOX") shapes.push_back(std::make_shared<Box>(1.0f, 1));
-        else if (type == "CONE") shapes.push_back(std::make_shared<Cone>(1.0f, 1.0f, 1));
-        // TODO: Deserialize color + transforms
+    std::error_code ec;
+    uintmax_t size = std::filesystem::file_size(filename, ec);
+    if (ec) { std::cerr << "Cannot open file to read\n"; return; }
+    lazy.close();
+    if (size >= kLazyOpenBytes) {
+        std::string error;
+        if (lazy.open(filename, error)) std::cout << "Model opened from " << filename << ", " << lazy.pageCount() << " page(s) loaded on demand\n";
+        else { std::cerr << error << "\n"; lazy.close(); }
+    } else {
+        scene.load(filename);
     }
+    history.clear();
+    selectionSets.clear();
+    activeSet.clear();
+    ensureGroupRoot();
+    currentNode = nullptr;
+    currentIndex = 0;
+    reselect();
+    frameShapes();
+}
 
-    if (!shapes.empty()) { currentShapeIndex = 0; currentShape = shapes[0]; }
-    std::cout << "Model loaded from " << filename << "\n";
+// Click to select: ray-cast from the cursor instead of cycling with Tab.
+void pickShape(double x, double y, int width, int height) {
+    Ray ray = rayFromCursor(x, y, width, height, view, projection);
+    int hit = scene.pick(ray);
+    if (hit < 0) { std::cout << "Nothing under the cursor\n"; return; }
+    selectNode(hit);
+    std::cout << "Picked shape " << currentIndex << "\n";
+}
+
+// Lists every pair of overlapping shapes (numbered as in "Picked shape N") and
+// selects the first shape of the first pair.
+void checkInterference() {
+    scene.updateWorld();
+    const FlatHierarchy &h = scene.hierarchy();
+    std::vector<InterferenceItem> items;
+    for (size_t i = 0; i < h.size(); i++)
+        if (h.shapes[i]) items.push_back({(uint32_t)i, h.shapes[i]->shapetype, h.world[i], h.bounds[i]});
+    InterferenceChecker::Result r = InterferenceChecker().check(items);
+    for (auto &p : r.pairs) std::cout << "Shapes " << p.first << " and " << p.second << " overlap\n";
+    std::cout << r.pairs.size() << " interference(s) among " << items.size() << " shapes\n";
+    if (r.pairs.empty()) return;
+    selectNode((int)r.pairs[0].first);
+}
+
+void addShape(std::shared_ptr<Shape> s, const char* name) {
+    ensureGroupRoot();
+    std::shared_ptr<HNode> node = std::make_shared<HNode>(s);
+    history.insert(*scene.root, scene.root->getChildren().size(), node);
+    currentNode = node;
+    reselect();
+    std::cout << "Added " << name << "\n";
+}
+
+// Removes the current node and its subtree.
+void removeCurrent() {
+    scene.updateWorld();
+    const FlatHierarchy &h = scene.hierarchy();
+    if (currentIndex < 0 || h.parent[currentIndex] < 0) return;
+    HNode &parent = *h.nodes[h.parent[currentIndex]];
+    const auto &children = parent.getChildren();
+    auto it = std::find(children.begin(), children.end(), currentNode);
+    if (it == children.end()) { std::cout << "Cannot remove the root of a shared definition\n"; return; }
+    history.erase(parent, it - children.begin());
+    reselect();
+    std::cout << "Removed shape\n";
+}
+
+// The selected node, ready to change: the history has its state.
+HNode& editCurrent() {
+    history.modify(*currentNode);
+    return *currentNode;
+}
+
+void undoRedo(bool redo) {
+    if (!(redo ? history.redo() : history.undo())) { std::cout << "Nothing to " << (redo ? "redo" : "undo") << "\n"; return; }
+    reselect();
+    std::cout << (redo ? "Redo" : "Undo") << " (" << history.undoCount() << " step(s) to undo, " << history.redoCount() << " to redo)\n";
+}
+
+// N: "NAME QUERY" defines (or redefines) a named set of shapes and makes
+// transforms apply to it; see SelectionQuery for the queries.
+void defineSelectionSet() {
+    std::istringstream in(console.line("Selection set (NAME type T | color R G B [TOL] | region X0 Y0 Z0 X1 Y1 Z1 | subtree N | all): "));
+    std::string name, rest, error = "expected NAME QUERY";
+    SelectionQuery q;
+    in >> name;
+    std::getline(in, rest);
+    if (name.empty() || !SelectionQuery::parse(rest, q, error)) { std::cout << "Invalid selection set: " << error << "\n"; return; }
+    selectionSets.define(name, q, scene);
+    activeSet = name;
+    std::cout << "Selection set " << name << ": " << selectionSets.get(name, scene)->size()
+              << " node(s); transforms apply to it\n";
+}
+
+// B: chooses the set transforms apply to; an empty line goes back to the current shape.
+void chooseSelectionSet() {
+    std::string name = console.line("Transform selection set (empty for the current shape): ");
+    if (name.empty()) { activeSet.clear(); std::cout << "Transforms apply to the current shape\n"; return; }
+    if (!selectionSets.contains(name)) { std::cout << "No selection set " << name << "\n"; return; }
+    activeSet = name;
+    std::cout << "Transforms apply to selection set " << name << "\n";
+}
+
+// One +/- step on the active selection set (one parallel pass, one undo step),
+// or on the current shape if no set is active.
+void applyStep(TransformStep::Kind kind, float amount) {
+    TransformStep step{kind, activeAxis, amount};
+    if (!activeSet.empty()) {
+        if (const Selection *selection = selectionSets.get(activeSet, scene)) {
+            applyTransform(scene, *selection, step, &history);
+            return;
+        }
+    }
+    if (currentNode) step.apply(editCurrent(), true);
 }
 
 // Switch active shape
 void switchShape() {
-    if (shapes.empty()) return;
-    currentShapeIndex = (currentShapeIndex + 1) % shapes.size();
-    currentShape = shapes[currentShapeIndex];
-    std::cout << "Switched to shape " << currentShapeIndex + 1 << "\n";
+    scene.updateWorld();
+    const FlatHierarchy &h = scene.hierarchy();
+    for (size_t k = 1; k <= h.size(); k++) {
+        size_t i = (size_t)(currentIndex + k) % h.size();
+        if (!h.shapes[i]) continue;
+        selectNode((int)i);
+        std::cout << "Switched to shape " << i << "\n";
+        return;
+    }
 }
 
-// Key callback
-void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods) {
+// F: marks the current node's subtree as static, so inspection mode bakes it
+// on its own (see Model::bakeForInspection), or clears the mark.
+void toggleStatic() {
+    HNode &node = editCurrent();
+    node.setStatic(!node.isStatic());
+    std::cout << "Shape " << currentIndex << (node.isStatic() ? " marked static\n" : " no longer static\n");
+}
+
+// Inspection mode draws the scene's parts from a bake, made again when the
+// tree is re-flattened under it (a model loaded, say), since the bake is keyed
+// on node indices. A lazily opened model is drawn shape by shape instead: it
+// keeps paging, and each page attached would mean baking it all again.
+// Returns whether the bake changed. Needs the GL context and an idle pipeline.
+bool refreshBake() {
+    if (currentMode != MODE_INSPECTION || lazy.pageCount() || scene.bakeCurrent()) return false;
+    scene.bakeForInspection();
+    return true;
+}
+
+// Key handling, shared by the window and --replay
+void handleKey(int key, int action, int mods) {
     if (action != GLFW_PRESS) return;
 
-    if (key == GLFW_KEY_ESCAPE) glfwSetWindowShouldClose(window, true);
+    if (key == GLFW_KEY_ESCAPE) quitRequested = true;
 
-    if (key == GLFW_KEY_M) { currentMode = MODE_MODELLING; std::cout << "MODELLING mode\n"; return; }
-    if (key == GLFW_KEY_I) { currentMode = MODE_INSPECTION; std::cout << "INSPECTION mode\n"; return; }
+    if (key == GLFW_KEY_M) { currentMode = MODE_MODELLING; scene.dropBaked(); std::cout << "MODELLING mode\n"; return; }
+    if (key == GLFW_KEY_I) { currentMode = MODE_INSPECTION; refreshBake(); std::cout << "INSPECTION mode\n"; return; }
+    if (key == GLFW_KEY_O) {
+        occlusionCulling = !occlusionCulling;
+        std::cout << "Occlusion culling " << (occlusionCulling ? "on" : "off") << "\n";
+        return;
+    }
+    if (key == GLFW_KEY_P) {
+        sphereImpostors = !sphereImpostors;
+        std::cout << "Sphere impostors " << (sphereImpostors ? "on" : "off") << "\n";
+        return;
+    }
 
     if (currentMode == MODE_MODELLING) {
-        if (key == GLFW_KEY_1) { currentShape = std::make_shared<Sphere>(1.0f,1); shapes.push_back(currentShape); currentShapeIndex = shapes.size()-1; std::cout << "Added Sphere\n"; }
-        if (key == GLFW_KEY_2) { currentShape = std::make_shared<Cylinder>(1.0f,1.0f,1); shapes.push_back(currentShape); currentShapeIndex = shapes.size()-1; std::cout << "Added Cylinder\n"; }
-        if (key == GLFW_KEY_3) { currentShape = std::make_shared<Box>(1.0f,1); shapes.push_back(currentShape); currentShapeIndex = shapes.size()-1; std::cout << "Added Box\n"; }
-        if (key == GLFW_KEY_4) { currentShape = std::make_shared<Cone>(1.0f,1.0f,1); shapes.push_back(currentShape); currentShapeIndex = shapes.size()-1; std::cout << "Added Cone\n"; }
-        if (key == GLFW_KEY_5 && !shapes.empty()) { shapes.erase(shapes.begin() + currentShapeIndex); if(shapes.empty()) currentShape=nullptr; else currentShapeIndex%=shapes.size(); currentShape=shapes[currentShapeIndex]; std::cout << "Removed shape\n"; }
+        if ((mods & GLFW_MOD_CONTROL) && key == GLFW_KEY_Z) { undoRedo(mods & GLFW_MOD_SHIFT); return; }
+        if ((mods & GLFW_MOD_CONTROL) && key == GLFW_KEY_Y) { undoRedo(true); return; }
+
+        if (key == GLFW_KEY_1) addShape(std::make_shared<Sphere>(1.0f,1), "Sphere");
+        if (key == GLFW_KEY_2) addShape(std::make_shared<Cylinder>(1.0f,1.0f,1), "Cylinder");
+        if (key == GLFW_KEY_3) addShape(std::make_shared<Box>(1.0f,1), "Box");
+        if (key == GLFW_KEY_4) addShape(std::make_shared<Cone>(1.0f,1.0f,1), "Cone");
+        if (key == GLFW_KEY_5 && currentNode) removeCurrent();
         if (key == GLFW_KEY_TAB) switchShape();
+        if (key == GLFW_KEY_K) checkInterference();
+        if (key == GLFW_KEY_N) defineSelectionSet();
+        if (key == GLFW_KEY_B) chooseSelectionSet();
+        if (key == GLFW_KEY_F && currentNode) toggleStatic();
 
         if (key == GLFW_KEY_R) activeTransform = ROTATE;
         if (key == GLFW_KEY_T) activeTransform = TRANSLATE;
@@ -140,46 +382,185 @@ void key_callback(GLFWwindow* window, int key, int scancode, int action, int mod
         if (key == GLFW_KEY_Y) activeAxis='Y';
         if (key == GLFW_KEY_Z) activeAxis='Z';
 
-        if (currentShape) {
-            if (key == GLFW_KEY_KP_ADD || key == GLFW_KEY_EQUAL) {
-                if(activeTransform==ROTATE) currentShape->rotate(activeAxis, +5.0f);
-                if(activeTransform==TRANSLATE) currentShape->translate(activeAxis,+0.1f);
-                if(activeTransform==SCALE) currentShape->scale(activeAxis,1.1f);
-            }
-            if (key == GLFW_KEY_KP_SUBTRACT || key == GLFW_KEY_MINUS) {
-                if(activeTransform==ROTATE) currentShape->rotate(activeAxis,-5.0f);
-                if(activeTransform==TRANSLATE) currentShape->translate(activeAxis,-0.1f);
-                if(activeTransform==SCALE) currentShape->scale(activeAxis,0.9f);
-            }
+        if (key == GLFW_KEY_KP_ADD || key == GLFW_KEY_EQUAL) {
+            if(activeTransform==ROTATE) applyStep(TransformStep::ROTATE, +5.0f);
+            if(activeTransform==TRANSLATE) applyStep(TransformStep::TRANSLATE, +0.1f);
+            if(activeTransform==SCALE) applyStep(TransformStep::SCALE, 1.1f);
+        }
+        if (key == GLFW_KEY_KP_SUBTRACT || key == GLFW_KEY_MINUS) {
+            if(activeTransform==ROTATE) applyStep(TransformStep::ROTATE, -5.0f);
+            if(activeTransform==TRANSLATE) applyStep(TransformStep::TRANSLATE, -0.1f);
+            if(activeTransform==SCALE) applyStep(TransformStep::SCALE, 0.9f);
         }
 
-        if(key==GLFW_KEY_C && currentShape) {
+        if(key==GLFW_KEY_C && currentNode) {
             float r,g,b;
-            std::cout<<"Enter RGB (0-1): "; std::cin>>r>>g>>b;
-            currentShape->setColor(glm::vec3(r,g,b));
+            std::istringstream rgb(console.line("Enter RGB (0-1): "));
+            if (rgb>>r>>g>>b) editCurrent().getShape()->setColor(glm::vec3(r,g,b));
+            else std::cout<<"Invalid color\n";
         }
 
         if(key==GLFW_KEY_S) {
-            std::string fn; std::cout<<"Enter filename: "; std::cin>>fn; saveModel(fn);
+            std::string fn = console.line("Enter filename: "); saveModel(fn);
         }
     }
     else if(currentMode==MODE_INSPECTION) {
-        if(key==GLFW_KEY_L) { std::string fn; std::cout<<"Enter filename: "; std::cin>>fn; loadModel(fn); }
+        if(key==GLFW_KEY_L) { std::string fn = console.line("Enter filename: "); loadModel(fn); }
         if(key==GLFW_KEY_R) activeTransform=ROTATE;
         if(key==GLFW_KEY_X) activeAxis='X';
         if(key==GLFW_KEY_Y) activeAxis='Y';
         if(key==GLFW_KEY_Z) activeAxis='Z';
 
         if(activeTransform==ROTATE) {
-            for(auto& s: shapes) {
-                if(key==GLFW_KEY_KP_ADD || key==GLFW_KEY_EQUAL) s->rotate(activeAxis,+5.0f);
-                if(key==GLFW_KEY_KP_SUBTRACT || key==GLFW_KEY_MINUS) s->rotate(activeAxis,-5.0f);
+            float degrees = 0.0f;
+            if(key==GLFW_KEY_KP_ADD || key==GLFW_KEY_EQUAL) degrees = +5.0f;
+            if(key==GLFW_KEY_KP_SUBTRACT || key==GLFW_KEY_MINUS) degrees = -5.0f;
+            if(degrees != 0.0f) {
+                // every top-level part about its own origin, in one parallel pass and one undo step
+                scene.updateWorld();
+                const FlatHierarchy &h = scene.hierarchy();
+                Selection parts;
+                for (size_t i = 1; i < h.size(); i += h.subtreeSize[i]) parts.push_back((uint32_t)i);
+                applyTransform(scene, parts, {TransformStep::ROTATE, activeAxis, degrees}, &history);
             }
         }
     }
 }
 
-int main() {
+void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods) {
+    recorder.key(key, scancode, action, mods);
+    handleKey(key, action, mods);
+    if (quitRequested) glfwSetWindowShouldClose(window, true);
+}
+
+void mouse_button_callback(GLFWwindow* window, int button, int action, int mods) {
+    if (button != GLFW_MOUSE_BUTTON_LEFT || action != GLFW_PRESS || currentMode != MODE_MODELLING) return;
+    double x, y;
+    int w, h;
+    glfwGetCursorPos(window, &x, &y);
+    glfwGetWindowSize(window, &w, &h);
+    recorder.click(x, y, w, h);
+    pickShape(x, y, w, h);
+}
+
+// Draws a list made by fillDrawList() with the vshader/fshader program. Reads
+// only the list and the scene's baked buffer, never the tree, so it can run
+// while the next list is made. With occlusion culling on, hidden items are
+// taken out of the list first; with impostors on (and `impostorProgram`, the
+// impostor_vshader/impostor_fshader program, loaded), so are small spheres,
+// which are then drawn as quads.
+void renderFrame(DrawList& list, MeshBuffer& meshes, GLuint program, SphereImpostors& impostors, GLuint impostorProgram) {
+    glm::mat4 viewProjection = projection * view;
+    if (occlusionCulling) culler.cull(list, viewProjection, 800.0f/600.0f);
+    bool useImpostors = sphereImpostors && impostorProgram;
+    if (useImpostors) impostors.take(list, viewProjection, viewportWidth, viewportHeight);
+
+    glClearColor(0.2f,0.3f,0.3f,1.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    glUseProgram(program);
+    meshes.submit(list, program, viewProjection);
+    scene.drawBaked(list.baked, list.bake, program, viewProjection);
+    if (useImpostors) {
+        glUseProgram(impostorProgram);
+        impostors.submit(impostorProgram);
+    }
+}
+
+// Everything a frame does after input was handled, with the pipeline idle:
+// pages the lazy model in view, keeps the selection and the bake current and
+// draws the list traversed last. `bake` is scene.bakeId() from before the input.
+// Shared by the window and --replay, so replayed frames are the real ones.
+void drawFrame(FramePipeline& pipeline, uint64_t bake, MeshBuffer& meshes, GLuint program,
+               SphereImpostors& impostors, GLuint impostorProgram) {
+    // pages of a lazily opened model; they only stop being evicted
+    // once they may hold edits that could still be undone or saved
+    lazy.evictPages = history.undoCount() == 0 && history.redoCount() == 0;
+    lazy.update(projection * view);
+    if (currentNode) reselect();   // its page may have been evicted
+    refreshBake();
+    // the list in hand was made for the old bake and would leave its parts out
+    if (scene.bakeId() != bake) pipeline.next();
+
+    renderFrame(pipeline.next(), meshes, program, impostors, impostorProgram);
+}
+
+// --replay LOG: runs a recorded session against an offscreen context, printing
+// per-step timings as JSON lines. Stops early if the log presses Escape.
+// With checkAllocations (a -DMODELLER_COUNT_ALLOCATIONS build, see
+// `make alloc-check`), the log's FRAME steps are then drawn once more, with
+// meshes uploaded and every list and scratch buffer grown to size, and the
+// replay fails if any of them allocated.
+int runReplay(const std::string& path, bool checkAllocations) {
+    if (checkAllocations && !alloc::kCounting) { std::cerr << "--check-allocations needs a build with -DMODELLER_COUNT_ALLOCATIONS\n"; return 2; }
+    std::vector<InputEvent> events;
+    std::string error;
+    if (!readInputLog(path, events, error)) { std::cerr << error << "\n"; return 1; }
+
+    // The handlers chat on std::cout; keep that out of the timings and the report.
+    std::ostream report(std::cout.rdbuf());
+    std::ostringstream discard;
+    std::streambuf* coutBuf = std::cout.rdbuf(discard.rdbuf());
+
+    OffscreenContext ctx;
+    if (!ctx.create(800, 600)) { std::cout.rdbuf(coutBuf); return 1; }
+    GLuint program = loadShaderProgram("shaders/vshader.glsl", "shaders/fshader.glsl");
+    if (!program) { std::cout.rdbuf(coutBuf); return 1; }
+    GLuint impostorProgram = loadShaderProgram("shaders/impostor_vshader.glsl", "shaders/impostor_fshader.glsl");
+    MeshBuffer meshes;
+    meshes.waitForMeshes = checkAllocations;   // no uploads still arriving in the checked frames
+    SphereImpostors impostors;
+    glEnable(GL_DEPTH_TEST);
+    projection = glm::perspective(glm::radians(45.0f),800.0f/600.0f,0.1f,100.0f);
+    moveCamera(0);
+    int status = 0;
+    {
+        // as in the window, handlers only run while the worker is idle
+        FramePipeline pipeline(scene);
+        pipeline.waitIdle();
+        uint64_t bake = scene.bakeId();
+        auto frame = [&] {
+            drawFrame(pipeline, bake, meshes, program, impostors, impostorProgram);
+            glFinish();
+            pipeline.waitIdle();
+            bake = scene.bakeId();
+        };
+        replayInput(events, console, report,
+            [&](const InputEvent& e) { if (!quitRequested) handleKey(e.key, e.action, e.mods); },
+            [&](unsigned int held) { if (!quitRequested) moveCamera(held); },
+            [&](const InputEvent& e) { if (!quitRequested && currentMode == MODE_MODELLING) pickShape(e.x, e.y, e.width, e.height); },
+            [&] { frame(); discard.str(""); });
+        if (checkAllocations) {
+            uint64_t allocations = 0;
+            size_t frames = 0;
+            for (const InputEvent& e : events) {
+                if (e.kind != InputEvent::FRAME) continue;
+                moveCamera(e.held);
+                alloc::Scope scope;
+                frame();
+                allocations += scope.allocations();
+                frames++;
+            }
+            report << "{\"name\":\"alloc/replay_frames\",\"frames\":" << frames << ",\"allocations\":" << allocations << "}\n";
+            if (allocations) { std::cerr << path << ": " << allocations << " allocation(s) in steady-state frames\n"; status = 1; }
+        }
+    }
+    std::cout.rdbuf(coutBuf);
+    glDeleteProgram(program);
+    if (impostorProgram) glDeleteProgram(impostorProgram);
+    return status;
+}
+
+int main(int argc, char** argv) {
+    if (argc > 1 && std::string(argv[1]) == "--acmr-report") { return printVertexCacheReport(std::cout) ? 0 : 1; }
+    if (argc > 1 && std::string(argv[1]) == "--headless") return runHeadless(argc - 2, argv + 2);
+    if (argc > 1 && isBatchAction(argv[1])) return runBatch(argc - 1, argv + 1);
+    if (argc > 2 && std::string(argv[1]) == "--replay") return runReplay(argv[2], argc > 3 && std::string(argv[3]) == "--check-allocations");
+    if (argc > 2 && std::string(argv[1]) == "--record") {
+        if (!recorder.open(argv[2])) return 1;
+        console.recorder = &recorder;
+    }
+
     glfwInit();
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR,3);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR,3);
@@ -189,25 +570,49 @@ int main() {
     if(!window){std::cout<<"Failed to create window\n"; glfwTerminate(); return -1;}
     glfwMakeContextCurrent(window);
     glfwSetFramebufferSizeCallback(window,framebuffer_size_callback);
+    glfwGetFramebufferSize(window,&viewportWidth,&viewportHeight);
     glfwSetKeyCallback(window,key_callback);
+    glfwSetMouseButtonCallback(window,mouse_button_callback);
 
     if(!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)){std::cout<<"Failed to initialize GLAD\n"; return -1;}
     glEnable(GL_DEPTH_TEST);
 
     projection = glm::perspective(glm::radians(45.0f),800.0f/600.0f,0.1f,100.0f);
 
-    while(!glfwWindowShouldClose(window)){
-        moveCamera(window);
-
-        glClearColor(0.2f,0.3f,0.3f,1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-        for(auto& s: shapes) s->draw();
-
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+    // The program is rebuilt on a hidden shared context whenever the shader
+    // files change (see ShaderReloader).
+    glfwWindowHint(GLFW_VISIBLE,GLFW_FALSE);
+    GLFWwindow* compileContext=glfwCreateWindow(1,1,"",NULL,window);
+    glfwWindowHint(GLFW_VISIBLE,GLFW_TRUE);
+    int status = 0;
+    {
+        ShaderReloader shaders("shaders/vshader.glsl", "shaders/fshader.glsl",
+            [compileContext](bool use) { glfwMakeContextCurrent(use ? compileContext : nullptr); });
+        if(!shaders.program()){std::cout<<"Failed to load shaders\n"; status = -1;}
+        // without it, P leaves every sphere a mesh
+        GLuint impostorProgram = loadShaderProgram("shaders/impostor_vshader.glsl", "shaders/impostor_fshader.glsl");
+        MeshBuffer meshes;
+        SphereImpostors impostors;
+        // A worker traverses the scene into the next draw list while this
+        // thread draws the current one; input is handled in between, while
+        // the worker is idle, since the handlers edit the scene.
+        FramePipeline pipeline(scene);
+        while(status == 0 && !glfwWindowShouldClose(window)){
+            pipeline.waitIdle();
+            uint64_t bake = scene.bakeId();
+            glfwPollEvents();
+            unsigned int held = heldCameraKeys(window);
+            if (held) recorder.frame(held);
+            moveCamera(held);
+            shaders.poll();
+            drawFrame(pipeline, bake, meshes, shaders.program(), impostors, impostorProgram);
+
+            glfwSwapBuffers(window);
+        }
+        if (impostorProgram) glDeleteProgram(impostorProgram);
     }
 
+    glfwDestroyWindow(compileContext);
     glfwTerminate();
-    return 0;
+    return status;
 }
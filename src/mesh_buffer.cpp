@@ -0,0 +1,169 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <algorithm>
+#include <map>
+#include <utility>
+
+#include "frame_pipeline.cpp"
+#include "unit_mesh.cpp"
+
+// All unit meshes of all primitives and levels in one vertex buffer and one
+// index buffer under a single VAO. Each mesh keeps its own 0-based indices and
+// is drawn with glDrawElementsBaseVertex, so nothing is rebound between draws.
+//
+// Meshes are appended into spare capacity with glBufferSubData. When a buffer
+// is full it grows geometrically and the old contents are copied on the GPU
+// (glCopyBufferSubData), so adding a mesh never re-uploads the existing ones.
+//
+// submit() never waits for a mesh to be built: a level that is still being
+// generated in the background is drawn with the finest level below it that is
+// already available, and swapped in on the first frame after it is ready.
+class MeshBuffer {
+public:
+    // Wait for every mesh at its exact level instead (for snapshots).
+    bool waitForMeshes = false;
+
+    struct Allocation {
+        GLint baseVertex = 0;
+        size_t firstIndex = 0;
+        GLsizei indexCount = 0;
+    };
+
+    ~MeshBuffer() {
+        if (vao) glDeleteVertexArrays(1, &vao);
+        if (vbo) glDeleteBuffers(1, &vbo);
+        if (ibo) glDeleteBuffers(1, &ibo);
+    }
+
+    // Uploads every primitive at levels 1-4 up front (one allocation each).
+    void preloadAll() {
+        const ShapeType types[] = {ShapeType::SPHERE_SHAPE, ShapeType::CYLINDER_SHAPE, ShapeType::BOX_SHAPE, ShapeType::CONE_SHAPE};
+        for (ShapeType t : types)
+            for (unsigned int level = 1; level <= 4; level++) get(t, level);
+    }
+
+    // Returns where (type, level) lives, uploading it on first use.
+    const Allocation& get(ShapeType type, unsigned int level) {
+        auto key = std::make_pair((int)type, clampLevel(level));
+        auto it = allocations.find(key);
+        if (it != allocations.end()) return it->second;
+        return allocations[key] = add(unitMesh(type, key.second));
+    }
+
+    // Like get(), but never blocks on tessellation: if (type, level) is not built
+    // yet, its build is started and the finest coarser level that is already
+    // uploaded or built stands in. Level 1 is a few hundred triangles and is
+    // built on the spot if nothing else is available.
+    const Allocation& getOrProxy(ShapeType type, unsigned int level) {
+        level = clampLevel(level);
+        for (unsigned int l = level; l >= 1; l--) {
+            auto key = std::make_pair((int)type, l);
+            auto it = allocations.find(key);
+            if (it != allocations.end()) return it->second;
+            // only the requested level is queued; coarser ones are used if they happen to exist
+            if (const UnitMesh *m = unitMeshCache().ready(type, l, l == level)) return allocations[key] = add(*m);
+        }
+        return get(type, 1);
+    }
+
+    Allocation add(const UnitMesh &mesh) {
+        if (!vao) glGenVertexArrays(1, &vao);
+        size_t vbytes = mesh.positions.size() * sizeof(glm::vec3);
+        size_t ibytes = mesh.indices.size() * sizeof(unsigned int);
+        grow(vbo, vertexCapacity, vertexUsed, vertexUsed + vbytes);
+        grow(ibo, indexCapacity, indexUsed, indexUsed + ibytes);
+
+        Allocation a;
+        a.baseVertex = (GLint)(vertexUsed / sizeof(glm::vec3));
+        a.firstIndex = indexUsed / sizeof(unsigned int);
+        a.indexCount = (GLsizei)mesh.indices.size();
+
+        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+        glBufferSubData(GL_ARRAY_BUFFER, vertexUsed, vbytes, mesh.positions.data());
+        glBindBuffer(GL_COPY_WRITE_BUFFER, ibo);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, indexUsed, ibytes, mesh.indices.data());
+        vertexUsed += vbytes;
+        indexUsed += ibytes;
+        return a;
+    }
+
+    // Binds the one VAO used for the whole frame. `program` is the vshader/fshader pair, in use.
+    void bind(GLuint program) {
+        glBindVertexArray(vao);
+        if (program != boundProgram || layoutDirty) setupLayout(program);
+    }
+
+    void draw(const Allocation &a, const glm::mat4 &mvp, const glm::vec4 &color) {
+        glUniformMatrix4fv(mvpLocation, 1, GL_FALSE, glm::value_ptr(mvp));
+        // vColor has no array bound, so the generic attribute value is used for every vertex
+        if (colorLocation >= 0) glVertexAttrib4fv(colorLocation, glm::value_ptr(color));
+        glDrawElementsBaseVertex(GL_TRIANGLES, a.indexCount, GL_UNSIGNED_INT,
+                                 (void*)(a.firstIndex * sizeof(unsigned int)), a.baseVertex);
+    }
+
+    // Submits a frame's draw list without a single VAO or buffer switch.
+    void submit(const DrawList &list, GLuint program, const glm::mat4 &viewProjection) {
+        bind(program);
+        // items are sorted by mesh key, so the lookup runs once per run of equal meshes
+        uint32_t key = ~0u;
+        const Allocation *a = nullptr;
+        for (const DrawItem &item : list.items) {
+            if (item.key != key) {
+                key = item.key;
+                a = waitForMeshes ? &get(item.type, item.level) : &getOrProxy(item.type, item.level);
+                if (layoutDirty) setupLayout(program); // a first-time mesh may have grown the buffers
+            }
+            draw(*a, viewProjection * item.matrix, item.color);
+        }
+        glBindVertexArray(0);
+    }
+
+    size_t vertexBytes() const { return vertexUsed; }
+    size_t indexBytes() const { return indexUsed; }
+
+private:
+    std::map<std::pair<int, unsigned int>, Allocation> allocations;
+    GLuint vao = 0, vbo = 0, ibo = 0;
+    size_t vertexCapacity = 0, vertexUsed = 0;
+    size_t indexCapacity = 0, indexUsed = 0;
+    GLuint boundProgram = 0;
+    bool layoutDirty = true;
+    GLint mvpLocation = -1;
+    GLint colorLocation = -1;
+
+    void grow(GLuint &buffer, size_t &capacity, size_t used, size_t needed) {
+        if (needed <= capacity) return;
+        size_t newCapacity = std::max(needed, std::max(capacity * 2, (size_t)1 << 20));
+        GLuint grown;
+        glGenBuffers(1, &grown);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, grown);
+        glBufferData(GL_COPY_WRITE_BUFFER, newCapacity, nullptr, GL_STATIC_DRAW);
+        if (buffer) {
+            glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, used);
+            glDeleteBuffers(1, &buffer);
+        }
+        buffer = grown;
+        capacity = newCapacity;
+        layoutDirty = true;
+    }
+
+    void setupLayout(GLuint program) {
+        glBindVertexArray(vao);
+        GLint pos = glGetAttribLocation(program, "vPosition");
+        colorLocation = glGetAttribLocation(program, "vColor");
+        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+        if (pos >= 0) {
+            glEnableVertexAttribArray(pos);
+            glVertexAttribPointer(pos, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0); // w defaults to 1
+        }
+        if (colorLocation >= 0) glDisableVertexAttribArray(colorLocation);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
+        mvpLocation = glGetUniformLocation(program, "ModelViewProjectMatrix");
+        boundProgram = program;
+        layoutDirty = false;
+    }
+};
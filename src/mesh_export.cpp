@@ -0,0 +1,261 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "model.cpp"
+#include "bounds.cpp"
+#include "unit_mesh.cpp"
+
+// --- Mesh export ---
+// Writes the tessellated model as binary STL (one flat triangle soup in world
+// space) or glTF 2.0 (.gltf JSON plus a .bin buffer). Nothing is collected up
+// front: the tree is walked with a stack of one frame per level, and output
+// goes out in fixed-size chunks, so memory is the parsed model plus O(depth)
+// however many triangles are written. World matrices are the products of the
+// HNode transforms, as everywhere else (see FlatHierarchy).
+
+// Calls fn(shape, world) for every shape in pre-order, following instances.
+template <typename Fn>
+void forEachWorldShape(const HNode *root, Fn fn) {
+    struct Frame {
+        const HNode *node;
+        glm::mat4 world;
+        size_t next;     // next child to visit; children.size() means the instance
+    };
+    if (!root) return;
+    std::vector<Frame> stack;
+    stack.push_back({root, root->getLocalMatrix(), 0});
+    if (root->getShape()) fn(*root->getShape(), stack.back().world);
+    while (!stack.empty()) {
+        Frame &f = stack.back();
+        const auto &children = f.node->getChildren();
+        const HNode *child = nullptr;
+        if (f.next < children.size()) child = children[f.next].get();
+        else if (f.next == children.size()) child = f.node->getInstance().get();
+        else { stack.pop_back(); continue; }
+        f.next++;
+        if (!child) continue;
+        glm::mat4 world = f.world * child->getLocalMatrix();   // f may move once we push
+        stack.push_back({child, world, 0});
+        if (child->getShape()) fn(*child->getShape(), world);
+    }
+}
+
+inline unsigned int exportLevel(const Shape &s) {
+    return std::min(std::max(s.getLevel(), 1u), Model::kMaxLevel);
+}
+
+// --- Binary STL ---
+// 80-byte header, uint32 triangle count, then per triangle a normal, three
+// vertices (float32 little-endian) and a 16-bit attribute. The count is taken
+// in a first pass over the tree, so the output need not be seekable.
+inline bool exportStl(const Model &model, std::ostream &out) {
+    static const size_t kChunkTriangles = 8192;
+    const HNode *root = model.root.get();
+
+    uint64_t total = 0;
+    forEachWorldShape(root, [&](const Shape &s, const glm::mat4 &) {
+        total += unitMesh(s.shapetype, exportLevel(s)).triangleCount();
+    });
+    if (total > UINT32_MAX) { std::cerr << "STL export: " << total << " triangles exceed the format's limit\n"; return false; }
+
+    char header[80] = {};
+    std::snprintf(header, sizeof(header), "binary STL exported by modeller");
+    uint32_t count = (uint32_t)total;
+    out.write(header, sizeof(header));
+    out.write(reinterpret_cast<const char*>(&count), 4);
+
+    std::vector<char> chunk;
+    chunk.reserve(kChunkTriangles * 50);
+    std::vector<glm::vec3> world;
+    forEachWorldShape(root, [&](const Shape &s, const glm::mat4 &m) {
+        const UnitMesh &mesh = unitMesh(s.shapetype, exportLevel(s));
+        world.resize(mesh.positions.size());
+        for (size_t v = 0; v < world.size(); v++) world[v] = glm::vec3(m * glm::vec4(mesh.positions[v], 1.0f));
+        bool mirrored = glm::determinant(glm::mat3(m)) < 0.0f;   // keep faces wound outwards
+
+        for (size_t t = 0; t < mesh.indices.size(); t += 3) {
+            glm::vec3 tri[3] = {world[mesh.indices[t]], world[mesh.indices[t + 1]], world[mesh.indices[t + 2]]};
+            if (mirrored) std::swap(tri[1], tri[2]);
+            glm::vec3 n = glm::cross(tri[1] - tri[0], tri[2] - tri[0]);
+            float len = glm::length(n);
+            n = len > 0.0f ? n / len : glm::vec3(0.0f);
+
+            float record[12] = {n.x, n.y, n.z};
+            for (int k = 0; k < 3; k++) std::memcpy(&record[3 + 3 * k], &tri[k], 12);
+            size_t at = chunk.size();
+            chunk.resize(at + 50);
+            std::memcpy(&chunk[at], record, 48);
+            chunk[at + 48] = chunk[at + 49] = 0;
+            if (chunk.size() >= kChunkTriangles * 50) { out.write(chunk.data(), chunk.size()); chunk.clear(); }
+        }
+    });
+    out.write(chunk.data(), chunk.size());
+    return (bool)out;
+}
+
+// --- glTF 2.0 ---
+// Each HNode becomes a glTF node with its local matrix; an instance's shared
+// definition is repeated under every instance node, since glTF nodes form a
+// strict tree. Every shape of one type, level and colour references the same
+// glTF mesh, and all meshes of one type and level share one pair of accessors,
+// so the .bin holds each used unit mesh once whatever the node count.
+// Nodes are numbered in post-order, in the order they are written: a node is
+// written once all of its children are, so their indices are already known.
+// The walk keeps a stack of one frame per level and the indices of the
+// finished children of each frame; nothing is kept per node, and a shared
+// definition is simply walked again under each instance. The root comes last.
+// The mesh and material tables grow with the number of distinct colours, not
+// with nodes. Empty tables are left out, as glTF requires of its top-level
+// arrays.
+class GltfExporter {
+public:
+    bool write(const Model &model, std::ostream &json, std::ostream &bin, const std::string &binUri) {
+        if (!model.root) return false;
+        json << "{\"asset\":{\"version\":\"2.0\",\"generator\":\"modeller\"},\"nodes\":[";
+
+        struct Frame {
+            const HNode *node;
+            size_t next;      // position of the next child, see child()
+            size_t first;     // where this node's children start in `done`
+        };
+        std::vector<Frame> stack{{model.root.get(), 0, 0}};
+        std::vector<uint64_t> done;   // indices of written children of the nodes on the stack
+        uint64_t written = 0;
+        while (!stack.empty()) {
+            Frame &f = stack.back();
+            if (const HNode *c = child(f.node, f.next)) {
+                stack.push_back({c, 0, done.size()});
+                continue;
+            }
+            const HNode *node = f.node;
+            json << (written ? ",{" : "{");
+            bool first = true;
+            auto key = [&](const char *k) { json << (first ? "\"" : ",\"") << k << "\":"; first = false; };
+
+            if (node->getLocalMatrix() != glm::mat4(1.0f)) {
+                key("matrix");
+                const float *m = &node->getLocalMatrix()[0][0];   // column-major, as glTF expects
+                json << "[";
+                for (int k = 0; k < 16; k++) json << (k ? "," : "") << number(m[k]);
+                json << "]";
+            }
+            if (const auto &s = node->getShape()) { key("mesh"); json << meshIndex(*s); }
+            if (f.first < done.size()) {
+                key("children");
+                for (size_t k = f.first; k < done.size(); k++) json << (k == f.first ? "[" : ",") << done[k];
+                json << "]";
+            }
+            json << "}";
+
+            done.resize(f.first);
+            stack.pop_back();
+            done.push_back(written++);
+        }
+        json << "],\"scene\":0,\"scenes\":[{\"nodes\":[" << written - 1 << "]}]";
+
+        writeMeshes(json);
+        uint64_t length = writeBuffers(json, bin);
+        if (length) {
+            json << ",\"buffers\":[{\"uri\":\"";
+            for (char c : binUri) { if (c == '"' || c == '\\') json << '\\'; json << c; }
+            json << "\",\"byteLength\":" << length << "}]";
+        }
+        json << "}\n";
+        return json && bin;
+    }
+
+private:
+    using MeshKey = std::tuple<int, unsigned int, float, float, float>;   // type, level, colour
+    std::map<MeshKey, size_t> meshes;
+    std::map<std::tuple<float, float, float>, size_t> materials;
+    std::map<std::pair<int, unsigned int>, size_t> geometries;           // (type, level) -> accessor pair
+
+    // The next child of `node` in the glTF tree from position k on, k moved
+    // past it, or nullptr after the last. The glTF children are the node's
+    // non-null children, then its instance's definition.
+    static const HNode* child(const HNode *node, size_t &k) {
+        const auto &children = node->getChildren();
+        for (; k < children.size(); k++) if (children[k]) return children[k++].get();
+        return k++ == children.size() ? node->getInstance().get() : nullptr;
+    }
+
+    static std::string number(float v) {
+        char b[32];
+        std::snprintf(b, sizeof(b), "%.9g", v);
+        return b;
+    }
+
+    size_t meshIndex(const Shape &s) {
+        glm::vec3 c = s.getColor();
+        unsigned int level = exportLevel(s);
+        auto it = meshes.emplace(MeshKey{(int)s.shapetype, level, c.r, c.g, c.b}, meshes.size()).first;
+        materials.emplace(std::make_tuple(c.r, c.g, c.b), materials.size());
+        geometries.emplace(std::make_pair((int)s.shapetype, level), geometries.size());
+        return it->second;
+    }
+
+    void writeMeshes(std::ostream &json) {
+        std::vector<const MeshKey*> byIndex(meshes.size());
+        for (auto &m : meshes) byIndex[m.second] = &m.first;
+        if (byIndex.empty()) return;   // no shapes, so no materials either
+        json << ",\"meshes\":[";
+        for (size_t i = 0; i < byIndex.size(); i++) {
+            auto [type, level, r, g, b] = *byIndex[i];
+            size_t geometry = geometries.at({type, level});
+            json << (i ? "," : "") << "{\"primitives\":[{\"attributes\":{\"POSITION\":" << 2 * geometry
+                 << "},\"indices\":" << 2 * geometry + 1 << ",\"material\":" << materials.at({r, g, b}) << "}]}";
+        }
+        json << "]";
+
+        std::vector<std::tuple<float, float, float>> colours(materials.size());
+        for (auto &m : materials) colours[m.second] = m.first;
+        json << ",\"materials\":[";
+        for (size_t i = 0; i < colours.size(); i++) {
+            auto [r, g, b] = colours[i];
+            json << (i ? "," : "") << "{\"pbrMetallicRoughness\":{\"baseColorFactor\":[" << number(r) << "," << number(g)
+                 << "," << number(b) << ",1],\"metallicFactor\":0}}";
+        }
+        json << "]";
+    }
+
+    // Positions then indices of each used unit mesh, one buffer view and accessor each.
+    uint64_t writeBuffers(std::ostream &json, std::ostream &bin) {
+        std::vector<std::pair<int, unsigned int>> byIndex(geometries.size());
+        for (auto &g : geometries) byIndex[g.second] = g.first;
+        std::ostringstream views, accessors;
+        uint64_t offset = 0;
+        for (size_t i = 0; i < byIndex.size(); i++) {
+            const UnitMesh &mesh = unitMesh((ShapeType)byIndex[i].first, byIndex[i].second);
+            AABB box;
+            for (auto &p : mesh.positions) box.expand(p);
+            uint64_t positionBytes = mesh.positions.size() * 12, indexBytes = mesh.indices.size() * 4;
+            bin.write(reinterpret_cast<const char*>(mesh.positions.data()), positionBytes);
+            bin.write(reinterpret_cast<const char*>(mesh.indices.data()), indexBytes);
+
+            views << (i ? "," : "") << "{\"buffer\":0,\"byteOffset\":" << offset << ",\"byteLength\":" << positionBytes
+                  << ",\"target\":34962},{\"buffer\":0,\"byteOffset\":" << offset + positionBytes
+                  << ",\"byteLength\":" << indexBytes << ",\"target\":34963}";
+            accessors << (i ? "," : "") << "{\"bufferView\":" << 2 * i << ",\"componentType\":5126,\"count\":"
+                      << mesh.positions.size() << ",\"type\":\"VEC3\",\"min\":[" << number(box.min.x) << "," << number(box.min.y)
+                      << "," << number(box.min.z) << "],\"max\":[" << number(box.max.x) << "," << number(box.max.y) << ","
+                      << number(box.max.z) << "]},{\"bufferView\":" << 2 * i + 1
+                      << ",\"componentType\":5125,\"count\":" << mesh.indices.size() << ",\"type\":\"SCALAR\"}";
+            offset += positionBytes + indexBytes;
+        }
+        if (byIndex.empty()) return 0;
+        json << ",\"bufferViews\":[" << views.str() << "],\"accessors\":[" << accessors.str() << "]";
+        return offset;
+    }
+};
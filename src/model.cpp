@@ -1,118 +1,440 @@
-#include <glm/glm.hpp>
-#include <fstream>
-#include <sstream>
-#include <iostream>
-#include <vector>
-#include <memory>
-#include <stack>
-
-#include "sphere.cpp"
-#include "cylinder.cpp"
-#include "box.cpp"
-#include "cone.cpp"
-
-class HNode {
-public:
-    std::shared_ptr<Shape> shape;
-    std::vector<std::shared_ptr<HNode>> children;
-
-    HNode(std::shared_ptr<Shape> s) : shape(s) {}
-};
-
-class Model {
-public:
-    std::shared_ptr<HNode> root = nullptr;
-
-    void draw() { drawNode(root); }
-
-    // --- Saving ---
-    void save(const std::string &filename) {
-        std::ofstream out(filename);
-        if (!out) { std::cerr << "Cannot open file to write\n"; return; }
-        out << "# MyModel Hierarchy v1\n";
-        saveNode(out, root, 0);
-        std::cout << "Model saved to " << filename << "\n";
-    }
-
-    // --- Loading ---
-    void load(const std::string &filename) {
-        std::ifstream in(filename);
-        if (!in) { std::cerr << "Cannot open file to read\n"; return; }
-
-        std::stack<std::shared_ptr<HNode>> nodeStack;
-        std::shared_ptr<HNode> currentNode = nullptr;
-        root = nullptr;
-
-        std::string line;
-        while (std::getline(in, line)) {
-            if (line.empty() || line[0]=='#') continue;
-            std::istringstream iss(line);
-            std::string token;
-            iss >> token;
-
-            if (token=="NODE") {
-                std::string type; unsigned int level; 
-                float tx,ty,tz,rx,ry,rz,sx,sy,sz,r,g,b;
-                iss >> type >> level >> tx >> ty >> tz >> rx >> ry >> rz >> sx >> sy >> sz >> r >> g >> b;
-
-                std::shared_ptr<Shape> s = nullptr;
-                if(type=="SPHERE") s = std::make_shared<Sphere>(1.0f,level);
-                else if(type=="BOX") s = std::make_shared<Box>(1.0f,level);
-                else if(type=="CYLINDER") s = std::make_shared<Cylinder>(1.0f,1.0f,level);
-                else if(type=="CONE") s = std::make_shared<Cone>(1.0f,1.0f,level);
-
-                if(s) {
-                    s->translate('X',tx); s->translate('Y',ty); s->translate('Z',tz);
-                    s->rotate('X',rx); s->rotate('Y',ry); s->rotate('Z',rz);
-                    s->scale('X',sx); s->scale('Y',sy); s->scale('Z',sz);
-                    s->setColor(glm::vec3(r,g,b));
-                }
-
-                std::shared_ptr<HNode> node = std::make_shared<HNode>(s);
-                if (!root) root = node;
-                if(currentNode) currentNode->children.push_back(node);
-                nodeStack.push(node);
-                currentNode = node;
-            } 
-            else if(token=="CHILD") { /* just a marker */ }
-            else if(token=="ENDCHILD") { if(!nodeStack.empty()) nodeStack.pop(); if(!nodeStack.empty()) currentNode=nodeStack.top(); else currentNode=nullptr; }
-            else if(token=="ENDNODE") { if(!nodeStack.empty()) nodeStack.pop(); if(!nodeStack.empty()) currentNode=nodeStack.top(); else currentNode=nullptr; }
-        }
-
-        std::cout << "Model loaded from " << filename << "\n";
-    }
-
-private:
-    void drawNode(std::shared_ptr<HNode> node) {
-        if(!node) return;
-        if(node->shape) node->shape->draw();
-        for(auto &child : node->children) drawNode(child);
-    }
-
-    void saveNode(std::ofstream &out, std::shared_ptr<HNode> node, int indent) {
-        if(!node) return;
-        std::string ind(indent*2,' ');
-
-        auto &s = node->shape;
-        if(!s) return;
-
-        glm::vec3 col = s->getColor();
-        glm::vec3 scale = s->getScale();
-        glm::vec3 trans = s->getTranslation();
-        glm::vec3 rot = s->getRotation();
-
-        out << ind << "NODE " << s->getTypeName() << " " << s->getLevel() << " "
-            << trans.x << " " << trans.y << " " << trans.z << " "
-            << rot.x << " " << rot.y << " " << rot.z << " "
-            << scale.x << " " << scale.y << " " << scale.z << " "
-            << col.r << " " << col.g << " " << col.b << "\n";
-
-        if(!node->children.empty()) {
-            out << ind << "CHILD\n";
-            for(auto &child : node->children) saveNode(out, child, indent+1);
-            out << ind << "ENDCHILD\n";
-        }
-
-        out << ind << "ENDNODE\n";
-    }
-};
+#pragma once
+
+#include <glm/glm.hpp>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <vector>
+#include <functional>
+#include <map>
+#include <memory>
+
+#include "sphere.cpp"
+#include "cylinder.cpp"
+#include "box.cpp"
+#include "cone.cpp"
+#include "hnode.cpp"
+#include "parallel_update.cpp"
+#include "model_bounds.cpp"
+#include "static_bake.cpp"
+#include "picking.cpp"
+
+class Model {
+public:
+    std::shared_ptr<HNode> root = nullptr;
+
+    void draw() {
+        updateWorld();
+        for (size_t i = 0; i < flat.size(); i++) {
+            if (bakedRoot(i)) { i += flat.subtreeSize[i] - 1; continue; }
+            Shape *s = flat.shapes[i];
+            if (!s) continue;
+            s->setModelMatrix(flat.world[i]);
+            s->draw();
+        }
+    }
+
+    // Recomputes world matrices and bounds; re-flattens only after the tree changed
+    // or a node's shape was replaced (HNode::setShape).
+    // Does nothing (and allocates nothing) if no node has moved since the last call.
+    void updateWorld() {
+        uint64_t shapes = HNode::shapeGeneration();
+        if (hierarchyDirty || shapes != flatShapes) {
+            flat.build(root.get());
+            hierarchyDirty = false;
+            flatShapes = shapes;
+            worldCurrent = false;
+            layout++;
+        }
+        uint64_t generation = HNode::transformGeneration();
+        if (worldCurrent && generation == worldGeneration) return;
+        updater.update(flat);
+        pickerStale = true;
+        worldGeneration = generation;
+        worldCurrent = true;
+    }
+
+    // --- Picking ---
+    // Index in hierarchy() of the nearest node whose shape the ray hits, or -1;
+    // an instanced node is told apart by its occurrence. The BVH is rebuilt on the
+    // first pick after the world bounds changed, i.e. after the tree changed or
+    // any node moved (HNode::transformGeneration()); picks in between reuse it.
+    int pick(const Ray &ray) {
+        updateWorld();
+        if (pickerStale) { picker.rebuild(flat.bounds); pickerStale = false; }
+        float t;
+        int hit = picker.pick(ray, [&](uint32_t i, ShapeType &type, const glm::mat4 *&world) {
+            if (!flat.shapes[i]) return false;
+            type = flat.shapes[i]->shapetype;
+            world = &flat.world[i];
+            return true;
+        }, t);
+        return hit;
+    }
+
+    const FlatHierarchy& hierarchy() const { return flat; }
+
+    // Changes whenever the tree is flattened again, i.e. whenever indices into
+    // hierarchy() may now name other nodes.
+    uint64_t layoutVersion() const { return layout; }
+
+    // --- Bounds ---
+    // World bounds and centroid of all shapes, for camera framing. Cached: only
+    // the parts of the model that moved since the last call are reduced again.
+    const ModelBounds& bounds() {
+        updateWorld();
+        extent.update(flat);
+        return extent;
+    }
+
+    // --- Inspection baking ---
+    // Only the rotation of the top-level parts is allowed in inspection mode, so
+    // every part (or just the static-marked subtrees, if there are any) is merged
+    // into one buffer on entry and dropped again when going back to modelling.
+    // Baking and dropping make GL calls, so they belong on the GL thread.
+    void bakeForInspection() {
+        updateWorld();
+        bool anyStatic = false;
+        for (auto *n : flat.nodes) anyStatic = anyStatic || n->isStatic();
+        baker.bake(flat, !anyStatic);
+        bakedLayout = layout;
+    }
+
+    void dropBaked() { baker.release(); }
+
+    // False once the tree has been re-flattened since the bake (a load, an
+    // added part, a LazyModel page attached): its ranges then name other nodes,
+    // and until it is made again bakedRoot() is false everywhere.
+    bool bakeCurrent() {
+        updateWorld();
+        return baker.id() && bakedLayout == layout;
+    }
+
+    // Whether node i roots a subtree drawn from the current bake.
+    bool bakedRoot(size_t i) const { return bakedLayout == layout && baker.covers(i); }
+    BakedDraw bakedDraw(size_t i) const { return baker.drawOf(flat, i); }
+    uint64_t bakeId() const { return baker.id(); }
+
+    void drawBaked(GLuint program, const glm::mat4 &viewProjection) { baker.draw(flat, program, viewProjection); }
+
+    // Draws the baked subtrees of a draw list (see fillDrawList).
+    void drawBaked(const std::vector<BakedDraw> &draws, uint64_t bake, GLuint program, const glm::mat4 &viewProjection) {
+        baker.draw(draws, bake, program, viewProjection);
+    }
+
+    // --- Saving ---
+    // Written to FILENAME.tmp and renamed over the file, so a failed save leaves
+    // the old file as it was (and a LazyModel's unloaded pages in it readable).
+    bool save(const std::string &filename) {
+        std::string tmp = filename + ".tmp";
+        std::ofstream out(tmp);
+        if (!out) { std::cerr << "Cannot open file to write\n"; return false; }
+        bool ok = write(out);
+        out.close();
+        std::error_code ec;
+        if (ok && !out.fail()) std::filesystem::rename(tmp, filename, ec);
+        if (!ok || out.fail() || ec) {
+            std::remove(tmp.c_str());
+            std::cerr << "Failed writing " << filename << "\n";
+            return false;
+        }
+        std::cout << "Model saved to " << filename << "\n";
+        return true;
+    }
+
+    // Asked for every node before write() writes it. The hook may write the node
+    // and everything under it itself (LazyModel copies the pages it has not
+    // loaded from the source file), or fail the whole write.
+    enum class WriteResult { NOT_HANDLED, WRITTEN, FAILED };
+    using WriteHook = std::function<WriteResult(const HNode &node, std::ostream &out)>;
+    WriteHook writeHook;
+
+    bool write(std::ostream &out) const {
+        out << "# MyModel Hierarchy v1\n";
+        std::map<const HNode*, std::string> names;
+        for (auto &d : definitions) {
+            out << "DEFINE " << d.first << "\n";
+            if (!saveNode(out, d.second, 1, names)) return false;
+            out << "ENDDEFINE\n";
+            names[d.second.get()] = d.first;
+        }
+        if (!saveNode(out, root, 0, names)) return false;
+        out.flush();
+        return (bool)out;
+    }
+
+    // --- Loading ---
+    bool load(const std::string &filename) {
+        std::ifstream in(filename);
+        if (!in) { std::cerr << "Cannot open file to read\n"; return false; }
+        std::string error;
+        if (!read(in, error)) { std::cerr << filename << ":" << error << "\n"; return false; }
+        std::cout << "Model loaded from " << filename << "\n";
+        return true;
+    }
+
+    // Parses a whole .mod stream. On a malformed file the model is left empty and
+    // `error` is set to "LINE: message".
+    //
+    // Repeated sub-assemblies can be written once and referenced many times:
+    //
+    //   DEFINE wheel                 top level only; one root NODE, may use earlier definitions
+    //     NODE CYLINDER ...
+    //     ENDNODE
+    //   ENDDEFINE
+    //   ...
+    //     INSTANCE wheel tx ty tz rx ry rz sx sy sz    anywhere a NODE may appear
+    //
+    // Every INSTANCE points at the same in-memory subtree; copies only exist in the
+    // flattened hierarchy that is rebuilt for drawing.
+    //
+    // A NODE or INSTANCE line may end in STATIC, marking its subtree as one to
+    // bake on its own in inspection mode (see bakeForInspection).
+    //
+    // A file with several top-level nodes (the modeller's parts) gets a grouping
+    // root without a shape, with those nodes as its children.
+    bool read(std::istream &in, std::string &error) {
+        baker.release();
+        root = nullptr;
+        definitions.clear();
+        hierarchyDirty = true;
+        if (parse(in, error, root)) return true;
+        root = nullptr;
+        definitions.clear();
+        return false;
+    }
+
+    // Asked at the byte offset of every line where a node of the main tree may
+    // start. Returning a node puts it there in place of the subtree(s) the hook
+    // skipped, after moving `offset` past them (see LazyModel).
+    using SkipHook = std::function<std::shared_ptr<HNode>(uint64_t &offset)>;
+
+    // The parser behind read(). Top-level nodes become `top`, or children of `group`
+    // when one is given (a run of sibling subtrees). DEFINE blocks are appended to
+    // `definitions`; INSTANCE lines may use any definition already there.
+    bool parse(std::istream &in, std::string &error, std::shared_ptr<HNode> &top,
+               HNode *group = nullptr, const SkipHook *skip = nullptr) {
+        struct Open { std::shared_ptr<HNode> node; bool inChild; };
+        std::vector<Open> nodeStack;
+        std::map<std::string, std::shared_ptr<HNode>> byName(definitions.begin(), definitions.end());
+        std::string defining;                 // name of the open DEFINE block, if any
+        std::shared_ptr<HNode> definitionRoot;
+        std::shared_ptr<HNode> topGroup;      // set once a second top-level node is seen
+        size_t lineNo = 0;
+        uint64_t offset = 0;                  // byte offset of the next line
+        auto fail = [&](const std::string &msg) {
+            error = std::to_string(lineNo) + ": " + msg;
+            return false;
+        };
+        // Places a new node where the parser is: under the open CHILD block, or as
+        // the root of the model or of the open definition.
+        auto attach = [&](const std::shared_ptr<HNode> &node, const char *what) {
+            if (nodeStack.empty()) {
+                if (group && defining.empty()) { group->addChild(node); return true; }
+                if (defining.empty()) {
+                    if (!top) { top = node; return true; }
+                    if (!topGroup) { topGroup = std::make_shared<HNode>(); topGroup->addChild(top); top = topGroup; }
+                    topGroup->addChild(node);
+                    return true;
+                }
+                if (definitionRoot) { fail(std::string("more than one root ") + what + " in DEFINE " + defining); return false; }
+                definitionRoot = node;
+            } else {
+                if (!nodeStack.back().inChild) { fail(std::string(what) + " outside a CHILD block"); return false; }
+                nodeStack.back().node->addChild(node);
+            }
+            return true;
+        };
+
+        std::string line;
+        while (true) {
+            if (skip && defining.empty() && (nodeStack.empty() || nodeStack.back().inChild)) {
+                uint64_t resume = offset;
+                if (std::shared_ptr<HNode> stub = (*skip)(resume)) {
+                    if (!attach(stub, "page")) return false;
+                    if (resume != offset) { offset = resume; in.clear(); in.seekg((std::streamoff)offset); }
+                    continue;
+                }
+            }
+            if (!std::getline(in, line)) break;
+            lineNo++;
+            offset += line.size() + 1;
+            std::istringstream iss(line);
+            std::string token;
+            if (!(iss >> token) || token[0]=='#') continue;
+
+            if (token=="NODE") {
+                std::string type; unsigned int level;
+                float tx,ty,tz,rx,ry,rz,sx,sy,sz,r,g,b;
+                if (!(iss >> type >> level >> tx >> ty >> tz >> rx >> ry >> rz >> sx >> sy >> sz >> r >> g >> b))
+                    return fail("malformed NODE line");
+                if (level < 1 || level > kMaxLevel) return fail("level " + std::to_string(level) + " out of range");
+                std::shared_ptr<Shape> s = createShape(type, level);
+                if (!s) return fail("unknown shape type " + type);
+                s->setColor(glm::vec3(r,g,b));
+
+                // The transform belongs to the node, so the node's children are
+                // placed relative to it and the world update sees it. A new node is
+                // picked up when the tree is flattened, so no generation bump.
+                std::shared_ptr<HNode> node = std::make_shared<HNode>(s);
+                node->setTransform(glm::vec3(tx,ty,tz), glm::vec3(rx,ry,rz), glm::vec3(sx,sy,sz), false);
+                node->setStatic(iss >> token && token == "STATIC");
+                if (!attach(node, "NODE")) return false;
+                nodeStack.push_back({node, false});
+            }
+            else if(token=="INSTANCE") {
+                std::string name;
+                float tx,ty,tz,rx,ry,rz,sx,sy,sz;
+                if (!(iss >> name >> tx >> ty >> tz >> rx >> ry >> rz >> sx >> sy >> sz))
+                    return fail("malformed INSTANCE line");
+                auto def = byName.find(name);
+                if (def == byName.end()) return fail("INSTANCE of undefined " + name);
+                std::shared_ptr<HNode> node = std::make_shared<HNode>();
+                node->setTransform(glm::vec3(tx,ty,tz), glm::vec3(rx,ry,rz), glm::vec3(sx,sy,sz), false);   // as for NODE
+                node->setStatic(iss >> token && token == "STATIC");
+                node->setInstance(def->second);
+                if (!attach(node, "INSTANCE")) return false;
+            }
+            else if(token=="DEFINE") {
+                std::string name;
+                if (!(iss >> name)) return fail("DEFINE without a name");
+                if (!defining.empty() || !nodeStack.empty() || group) return fail("DEFINE must be at the top level");
+                if (byName.count(name)) return fail("duplicate DEFINE " + name);
+                defining = name;
+                definitionRoot = nullptr;
+            }
+            else if(token=="ENDDEFINE") {
+                if (defining.empty()) return fail("ENDDEFINE without DEFINE");
+                if (!nodeStack.empty()) return fail("ENDDEFINE with open NODE(s)");
+                if (!definitionRoot) return fail("empty DEFINE " + defining);
+                byName[defining] = definitionRoot;
+                definitions.push_back({defining, definitionRoot});
+                defining.clear();
+            }
+            else if(token=="CHILD") {
+                if (nodeStack.empty() || nodeStack.back().inChild) return fail("CHILD without an open NODE");
+                nodeStack.back().inChild = true;
+            }
+            else if(token=="ENDCHILD") {
+                if (nodeStack.empty() || !nodeStack.back().inChild) return fail("ENDCHILD without CHILD");
+                nodeStack.back().inChild = false;
+            }
+            else if(token=="ENDNODE") {
+                if (nodeStack.empty()) return fail("ENDNODE without NODE");
+                if (nodeStack.back().inChild) return fail("ENDNODE inside an open CHILD block");
+                nodeStack.pop_back();
+            }
+            else return fail("unknown token " + token);
+        }
+        if (!nodeStack.empty()) return fail("unexpected end of file, " + std::to_string(nodeStack.size()) + " NODE(s) still open");
+        if (!defining.empty()) return fail("unexpected end of file inside DEFINE " + defining);
+        return true;
+    }
+
+    // Named subtrees shared by INSTANCE nodes, in file order.
+    std::vector<std::pair<std::string, std::shared_ptr<HNode>>> definitions;
+
+    // Call after changing the tree from outside (e.g. attaching a paged-in subtree).
+    void invalidateHierarchy() { hierarchyDirty = true; }
+
+    static constexpr unsigned int kMaxLevel = kMaxTessellationLevel;
+
+    // nullptr for an unknown type name
+    static std::shared_ptr<Shape> createShape(const std::string &type, unsigned int level) {
+        if(type=="SPHERE") return std::make_shared<Sphere>(1.0f,level);
+        if(type=="BOX") return std::make_shared<Box>(1.0f,level);
+        if(type=="CYLINDER") return std::make_shared<Cylinder>(1.0f,1.0f,level);
+        if(type=="CONE") return std::make_shared<Cone>(1.0f,1.0f,level);
+        return nullptr;
+    }
+
+    // A new shape of the same type, transform and colour as `s`, at `level`.
+    static std::shared_ptr<Shape> copyShape(const Shape &s, unsigned int level) {
+        std::shared_ptr<Shape> r = createShape(s.getTypeName(), level);
+        glm::vec3 t = s.getTranslation(), rot = s.getRotation(), sc = s.getScale();
+        r->translate('X',t.x); r->translate('Y',t.y); r->translate('Z',t.z);
+        r->rotate('X',rot.x); r->rotate('Y',rot.y); r->rotate('Z',rot.z);
+        r->scale('X',sc.x); r->scale('Y',sc.y); r->scale('Z',sc.z);
+        r->setColor(s.getColor());
+        return r;
+    }
+
+private:
+    FlatHierarchy flat;
+    HierarchyUpdater updater;
+    StaticBaker baker;
+    Picker picker;
+    ModelBounds extent;
+    bool hierarchyDirty = true;
+    bool pickerStale = true;         // flat.bounds changed since the BVH was built
+    bool worldCurrent = false;       // flat.world matches worldGeneration
+    uint64_t worldGeneration = 0;
+    uint64_t flatShapes = 0;         // HNode::shapeGeneration() when flat was built
+    uint64_t layout = 0;
+    uint64_t bakedLayout = 0;        // layout when the baker's ranges were made
+
+    static bool identity(const HNode &n) {
+        return n.getTranslation() == glm::vec3(0.0f) && n.getRotation() == glm::vec3(0.0f) && n.getScale() == glm::vec3(1.0f);
+    }
+
+    // False if the subtree has a node the format cannot express.
+    bool saveNode(std::ostream &out, const std::shared_ptr<HNode> &node, int indent,
+                  const std::map<const HNode*, std::string> &names) const {
+        if(!node) return true;
+        if (writeHook) {
+            WriteResult r = writeHook(*node, out);
+            if (r != WriteResult::NOT_HANDLED) return r == WriteResult::WRITTEN;
+        }
+        std::string ind(indent*2,' ');
+
+        if (auto &def = node->getInstance()) {
+            auto name = names.find(def.get());
+            if (name == names.end()) {
+                // Not one of this model's definitions (e.g. a LazyModel page that is
+                // loaded): the subtree is written in the node's place, which is only
+                // the same model if the node adds nothing to it.
+                if (node->getShape() || !node->getChildren().empty() || !identity(*node)) return false;
+                return saveNode(out, def, indent, names);
+            }
+            glm::vec3 t = node->getTranslation(), r = node->getRotation(), sc = node->getScale();
+            out << ind << "INSTANCE " << name->second << " "
+                << t.x << " " << t.y << " " << t.z << " "
+                << r.x << " " << r.y << " " << r.z << " "
+                << sc.x << " " << sc.y << " " << sc.z << (node->isStatic() ? " STATIC\n" : "\n");
+            return true;
+        }
+
+        auto &s = node->getShape();
+        if(!s) {
+            // A grouping node (see parse) is written as its children in its place,
+            // which is only the same model while it leaves them where they are.
+            if (!identity(*node)) return false;
+            for (auto &child : node->getChildren())
+                if (!saveNode(out, child, indent, names)) return false;
+            return true;
+        }
+
+        glm::vec3 col = s->getColor();
+        glm::vec3 scale = node->getScale();
+        glm::vec3 trans = node->getTranslation();
+        glm::vec3 rot = node->getRotation();
+
+        out << ind << "NODE " << s->getTypeName() << " " << s->getLevel() << " "
+            << trans.x << " " << trans.y << " " << trans.z << " "
+            << rot.x << " " << rot.y << " " << rot.z << " "
+            << scale.x << " " << scale.y << " " << scale.z << " "
+            << col.r << " " << col.g << " " << col.b << (node->isStatic() ? " STATIC\n" : "\n");
+
+        if(!node->getChildren().empty()) {
+            out << ind << "CHILD\n";
+            for(auto &child : node->getChildren())
+                if (!saveNode(out, child, indent+1, names)) return false;
+            out << ind << "ENDCHILD\n";
+        }
+
+        out << ind << "ENDNODE\n";
+        return true;
+    }
+};
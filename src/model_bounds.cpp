@@ -0,0 +1,133 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "bounds.cpp"
+#include "parallel_update.cpp"
+
+// --- Model bounds ---
+// Extent and centroid of a model for camera framing. The per-node world
+// bounds already come out of the hierarchy update (the analytic bounds of each
+// primitive's unit mesh pushed through its world matrix), so this is a single
+// min/max/sum reduction over them: SSE2 where available, one chunk of
+// ChunkFlags::kShift nodes per task. Chunk results are kept; after an edit only
+// the chunks the updater flagged are reduced again and the few hundred chunk
+// results are folded, so moving one part of a million-node model costs one
+// chunk, and an unchanged model costs nothing.
+
+// Bounds, sum of bounds centres and number of shapes over a run of node bounds.
+// Empty boxes (grouping nodes) are skipped.
+struct BoundsSum {
+    AABB box;
+    double centreSum[3] = {0.0, 0.0, 0.0};
+    size_t shapes = 0;
+
+    void add(const BoundsSum &o) {
+        box.expand(o.box);
+        for (int k = 0; k < 3; k++) centreSum[k] += o.centreSum[k];
+        shapes += o.shapes;
+    }
+
+    // Mean of the shapes' bounds centres; the origin if there are none.
+    glm::vec3 centroid() const {
+        if (!shapes) return glm::vec3(0.0f);
+        double n = (double)shapes;
+        return glm::vec3((float)(centreSum[0] / n), (float)(centreSum[1] / n), (float)(centreSum[2] / n));
+    }
+};
+
+static_assert(sizeof(AABB) == 6 * sizeof(float), "reduceBounds reads AABB as six packed floats");
+
+inline BoundsSum reduceBounds(const AABB *boxes, size_t count) {
+    BoundsSum r;
+    if (count == 0) return r;
+    size_t i = 0;
+    // centres are summed as min + max and halved at the end
+    float sum[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+#if defined(__SSE2__)
+    // One box per iteration: (min.xyz, max.x) and (max.xyz, next min.x); lane 3
+    // is ignored. The second load reads one float past the box, so the last box
+    // is left to the scalar loop.
+    __m128 lo = _mm_set1_ps(FLT_MAX), hi = _mm_set1_ps(-FLT_MAX), acc = _mm_setzero_ps();
+    for (; i + 1 < count; i++) {
+        const float *p = &boxes[i].min.x;
+        __m128 mn = _mm_loadu_ps(p);
+        __m128 mx = _mm_loadu_ps(p + 3);
+        lo = _mm_min_ps(lo, mn);
+        hi = _mm_max_ps(hi, mx);
+        acc = _mm_add_ps(acc, _mm_add_ps(mn, mx));   // an empty box adds FLT_MAX - FLT_MAX = 0
+        r.shapes += p[0] <= p[3];
+    }
+    float l[4], h[4];
+    _mm_storeu_ps(l, lo);
+    _mm_storeu_ps(h, hi);
+    _mm_storeu_ps(sum, acc);
+    r.box.min = glm::vec3(l[0], l[1], l[2]);
+    r.box.max = glm::vec3(h[0], h[1], h[2]);
+#endif
+    for (; i < count; i++) {
+        const AABB &b = boxes[i];
+        if (b.empty()) continue;
+        r.box.expand(b);
+        sum[0] += b.min.x + b.max.x;
+        sum[1] += b.min.y + b.max.y;
+        sum[2] += b.min.z + b.max.z;
+        r.shapes++;
+    }
+    for (int k = 0; k < 3; k++) r.centreSum[k] = 0.5 * sum[k];
+    return r;
+}
+
+class ModelBounds {
+public:
+    explicit ModelBounds(WorkStealingPool *pool = &sharedPool(), size_t serialChunks = 4)
+        : pool(pool), serialChunks(serialChunks) {}
+
+    // Catches up with h.bounds, reducing only the chunks flagged in
+    // h.boundsChanged, and clears those flags.
+    void update(FlatHierarchy &h) {
+        const ChunkFlags &flags = h.boundsChanged;
+        if (chunks.size() != flags.chunks()) chunks.assign(flags.chunks(), BoundsSum());
+        dirty.clear();
+        for (size_t c = 0; c < flags.chunks(); c++)
+            if (flags.test(c)) dirty.push_back(c);
+        if (dirty.empty() && valid) return;
+
+        auto reduce = [this, &h](size_t begin, size_t end) {
+            for (size_t k = begin; k < end; k++) {
+                size_t first = dirty[k] << ChunkFlags::kShift;
+                size_t n = std::min(h.size() - first, size_t(1) << ChunkFlags::kShift);
+                chunks[dirty[k]] = reduceBounds(h.bounds.data() + first, n);
+            }
+        };
+        if (!pool || dirty.size() <= serialChunks) reduce(0, dirty.size());
+        else pool->parallelFor(0, dirty.size(), 1, reduce);
+        for (size_t c : dirty) h.boundsChanged.clear(c);
+
+        total = BoundsSum();
+        for (auto &c : chunks) total.add(c);
+        valid = true;
+    }
+
+    // World bounds of every shape; empty if there are none.
+    const AABB& box() const { return total.box; }
+
+    glm::vec3 centroid() const { return total.centroid(); }
+
+    size_t shapeCount() const { return total.shapes; }
+
+private:
+    WorkStealingPool *pool;
+    size_t serialChunks;
+    std::vector<BoundsSum> chunks;
+    std::vector<size_t> dirty;
+    BoundsSum total;
+    bool valid = false;
+};
@@ -0,0 +1,178 @@
+#pragma once
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "tessellation_level.cpp"
+
+// --- Synthetic model generation ---
+// Streams a valid .mod hierarchy (same syntax as Model::save) of an exact node
+// count, without ever holding the tree in memory: the only state is one stack
+// frame per level of depth. The output depends on nothing but the options, so
+// the same seed gives byte-identical files on every machine.
+
+struct GeneratorOptions {
+    uint64_t nodes = 1000;
+    unsigned int depth = 8;        // maximum number of levels, root included
+    unsigned int branching = 8;    // maximum children per node
+    double mix[4] = {1, 1, 1, 1};  // relative weights of SPHERE, CYLINDER, BOX, CONE
+    unsigned int minLevel = 1;
+    unsigned int maxLevel = 4;
+    uint64_t seed = 1;
+    bool indent = true;            // indent like Model::save; off saves ~depth*2 bytes per line
+};
+
+// splitmix64: tiny, fast, and identical everywhere (unlike std:: distributions).
+class SplitMix64 {
+public:
+    explicit SplitMix64(uint64_t seed) : state(seed) {}
+
+    uint64_t next() {
+        uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+
+    double uniform() { return (next() >> 11) * (1.0 / 9007199254740992.0); } // [0,1)
+    double uniform(double lo, double hi) { return lo + (hi - lo) * uniform(); }
+    uint64_t below(uint64_t n) { return n ? next() % n : 0; }
+
+private:
+    uint64_t state;
+};
+
+class ModelGenerator {
+public:
+    static const char* typeName(int t) {
+        static const char *names[] = {"SPHERE", "CYLINDER", "BOX", "CONE"};
+        return names[t];
+    }
+
+    // Largest node count a tree of `depth` levels and `branching` children can hold (saturating).
+    static uint64_t capacity(unsigned int depth, unsigned int branching) {
+        uint64_t cap = 0;
+        for (unsigned int d = 0; d < depth; d++) {
+            if (cap > (UINT64_MAX - 1) / (branching ? branching : 1)) return UINT64_MAX;
+            cap = 1 + cap * branching;
+        }
+        return cap;
+    }
+
+    bool generate(const GeneratorOptions &opt, std::ostream &out, std::string &error) {
+        if (opt.nodes == 0) { error = "node count must be positive"; return false; }
+        if (opt.depth == 0) { error = "depth must be positive"; return false; }
+        if (opt.minLevel < 1 || opt.maxLevel > kMaxTessellationLevel || opt.minLevel > opt.maxLevel) {
+            error = "levels must lie in 1-" + std::to_string(kMaxTessellationLevel);
+            return false;
+        }
+        double totalWeight = opt.mix[0] + opt.mix[1] + opt.mix[2] + opt.mix[3];
+        if (!(totalWeight > 0)) { error = "primitive mix has no positive weight"; return false; }
+        if (opt.nodes > capacity(opt.depth, opt.branching)) {
+            error = "a tree of depth " + std::to_string(opt.depth) + " and branching " + std::to_string(opt.branching) +
+                    " holds at most " + std::to_string(capacity(opt.depth, opt.branching)) + " nodes";
+            return false;
+        }
+
+        SplitMix64 rng(opt.seed);
+        buffer.clear();
+        buffer.reserve(1 << 20);
+        append("# MyModel Hierarchy v1\n");
+
+        // Each frame owns a subtree budget (nodes still to emit under it, itself
+        // excluded) and knows its subtree's size, which sets its children's spread.
+        struct Frame { uint64_t budget; uint64_t childCount; uint64_t childIndex; uint64_t size; };
+        std::vector<Frame> stack;
+        uint64_t pending = opt.nodes; // budget of the next node to open, itself included
+        while (true) {
+            if (pending > 0) {
+                unsigned int depth = (unsigned int)stack.size();
+                writeNode(opt, rng, spread(stack.empty() ? opt.nodes : stack.back().size), totalWeight, depth);
+                Frame f{pending - 1, 0, 0, pending};
+                if (f.budget > 0) {
+                    f.childCount = std::min<uint64_t>(opt.branching, f.budget);
+                    indentLine(opt, depth);
+                    append("CHILD\n");
+                }
+                stack.push_back(f);
+                pending = 0;
+            }
+            Frame &top = stack.back();
+            if (top.childIndex < top.childCount) {
+                // Even split of what is left; every child can hold it because the
+                // capacity check above holds at every level.
+                uint64_t left = top.childCount - top.childIndex;
+                pending = top.budget / left + (top.budget % left ? 1 : 0);
+                top.budget -= pending;
+                top.childIndex++;
+                continue;
+            }
+            unsigned int depth = (unsigned int)stack.size() - 1;
+            if (top.childCount > 0) { indentLine(opt, depth); append("ENDCHILD\n"); }
+            indentLine(opt, depth);
+            append("ENDNODE\n");
+            stack.pop_back();
+            flush(out, false);
+            if (stack.empty()) break;
+        }
+        flush(out, true);
+        if (!out) { error = "write failed"; return false; }
+        return true;
+    }
+
+private:
+    std::string buffer;
+
+    void append(const char *s) { buffer += s; }
+
+    void appendFloat(double v) {
+        char tmp[32];
+        auto res = std::to_chars(tmp, tmp + sizeof(tmp), (float)v, std::chars_format::fixed, 3);
+        buffer.push_back(' ');
+        buffer.append(tmp, res.ptr);
+    }
+
+    void indentLine(const GeneratorOptions &opt, unsigned int depth) {
+        if (opt.indent) buffer.append(depth * 2, ' ');
+    }
+
+    void flush(std::ostream &out, bool force) {
+        if (!force && buffer.size() < (1u << 20)) return;
+        out.write(buffer.data(), buffer.size());
+        buffer.clear();
+    }
+
+    // Transforms are local to the parent (as in Model::parse), so they compound
+    // down the tree. A node is placed within +-spread of its parent's origin,
+    // in the parent's frame, with the spread growing with the cube root of the
+    // parent's subtree size: a subtree of n nodes fills a region about
+    // 4*cbrt(n) across around its root, with its children's smaller regions
+    // nested inside, so shapes neither pile up on their ancestors nor sit at
+    // the scale of the whole model. Scales stay near 1 (0.8-1.25, as likely to
+    // shrink as to grow), so deep nodes keep about unit size.
+    static double spread(uint64_t parentSize) { return 2.0 * std::cbrt((double)parentSize); }
+
+    void writeNode(const GeneratorOptions &opt, SplitMix64 &rng, double spread, double totalWeight, unsigned int depth) {
+        double pick = rng.uniform() * totalWeight;
+        int type = 0;
+        while (type < 3 && pick >= opt.mix[type]) pick -= opt.mix[type++];
+        while (type > 0 && opt.mix[type] <= 0) type--; // rounding at the top end
+        unsigned int level = opt.minLevel + (unsigned int)rng.below(opt.maxLevel - opt.minLevel + 1);
+
+        indentLine(opt, depth);
+        append("NODE ");
+        append(typeName(type));
+        buffer.push_back(' ');
+        buffer += std::to_string(level);
+        for (int i = 0; i < 3; i++) appendFloat(rng.uniform(-spread, spread));  // translation
+        for (int i = 0; i < 3; i++) appendFloat(rng.uniform(0.0, 360.0));      // rotation
+        for (int i = 0; i < 3; i++) appendFloat(std::exp(rng.uniform(-0.223, 0.223))); // scale, 0.8-1.25
+        for (int i = 0; i < 3; i++) appendFloat(rng.uniform());                // colour
+        buffer.push_back('\n');
+    }
+};
@@ -0,0 +1,245 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "bounds.cpp"
+#include "frame_pipeline.cpp"
+#include "unit_mesh.cpp"
+
+// --- Software occlusion culling ---
+// Each frame the largest items on screen are rasterized into a small CPU depth
+// buffer, and every item whose screen rectangle lies entirely behind that buffer
+// is dropped from the draw list before submission. Nothing touches the GPU, so
+// it works the same on the headless render nodes as on workstations.
+//
+// The test never hides something that is visible: occluders are drawn with the
+// level 1 mesh, which lies inside every finer tessellation of the same shape;
+// only pixels a triangle covers completely are written, at the farthest depth
+// the triangle reaches within the pixel; and an item is culled only if every
+// pixel its bounds touch is nearer than the nearest corner of the bounds.
+// Rows are processed four pixels at a time with SSE2 where available.
+
+class OcclusionBuffer {
+public:
+    static const int kWidth = 256;   // multiple of 4, one SIMD lane per pixel
+
+    void begin(const glm::mat4 &viewProjection, float aspect) {
+        vp = viewProjection;
+        height = std::min(std::max((int)std::lround(kWidth / std::max(aspect, 0.01f)), 16), 1024);
+        depth.assign((size_t)kWidth * height, 1.0f);
+    }
+
+    int width() const { return kWidth; }
+    int rows() const { return height; }
+
+    // Rasterizes a mesh placed by `world` as an occluder.
+    void rasterize(const UnitMesh &mesh, const glm::mat4 &world) {
+        glm::mat4 m = vp * world;
+        screen.resize(mesh.positions.size());
+        clipped.resize(mesh.positions.size());
+        for (size_t i = 0; i < mesh.positions.size(); i++) clipped[i] = !project(m * glm::vec4(mesh.positions[i], 1.0f), screen[i]);
+        for (size_t t = 0; t + 2 < mesh.indices.size(); t += 3) {
+            unsigned int a = mesh.indices[t], b = mesh.indices[t + 1], c = mesh.indices[t + 2];
+            // triangles reaching behind the near plane are skipped rather than clipped: fewer occluders, never wrong ones
+            if (clipped[a] || clipped[b] || clipped[c]) continue;
+            triangle(screen[a], screen[b], screen[c]);
+        }
+    }
+
+    // Screen rectangle of a box, in buffer pixels, and the window depth of its nearest corner.
+    struct ScreenRect {
+        glm::vec3 lo, hi;
+    };
+
+    // False if the box reaches behind the near plane.
+    bool project(const AABB &box, ScreenRect &r) const {
+        if (box.empty()) return false;
+        r.lo = glm::vec3(INFINITY);
+        r.hi = glm::vec3(-INFINITY);
+        // one matrix product; the other corners are the first plus scaled matrix columns
+        glm::vec3 size = box.max - box.min;
+        glm::vec4 base = vp * glm::vec4(box.min, 1.0f);
+        glm::vec4 ex = vp[0] * size.x, ey = vp[1] * size.y, ez = vp[2] * size.z;
+        for (int k = 0; k < 8; k++) {
+            glm::vec4 corner = base;
+            if (k & 1) corner += ex;
+            if (k & 2) corner += ey;
+            if (k & 4) corner += ez;
+            glm::vec3 p;
+            if (!project(corner, p)) return false;
+            r.lo = glm::min(r.lo, p);
+            r.hi = glm::max(r.hi, p);
+        }
+        return true;
+    }
+
+    // Fraction of the buffer the rectangle covers.
+    float coverage(const ScreenRect &r) const {
+        float w = std::min(r.hi.x, (float)kWidth) - std::max(r.lo.x, 0.0f);
+        float h = std::min(r.hi.y, (float)height) - std::max(r.lo.y, 0.0f);
+        return (w > 0.0f && h > 0.0f) ? w * h / ((float)kWidth * height) : 0.0f;
+    }
+
+    bool occluded(const AABB &box) const {
+        ScreenRect r;
+        return project(box, r) && occluded(r);
+    }
+
+    // True if everything inside the rectangle is certainly hidden behind what has been rasterized.
+    bool occluded(const ScreenRect &r) const {
+        const glm::vec3 &lo = r.lo, &hi = r.hi;
+        int x0 = std::max(0, (int)std::floor(lo.x)), x1 = std::min(kWidth - 1, (int)std::floor(hi.x));
+        int y0 = std::max(0, (int)std::floor(lo.y)), y1 = std::min(height - 1, (int)std::floor(hi.y));
+        if (x0 > x1 || y0 > y1) return false;   // off screen: the frustum's business, not ours
+        float zNear = lo.z;
+
+        for (int y = y0; y <= y1; y++) {
+            const float *row = &depth[(size_t)y * kWidth];
+#if defined(__SSE2__)
+            __m128 z = _mm_set1_ps(zNear);
+            for (int x = x0 & ~3; x <= x1; x += 4) {
+                __m128i lane = _mm_add_epi32(_mm_set1_epi32(x), _mm_set_epi32(3, 2, 1, 0));
+                __m128i inside = _mm_and_si128(_mm_cmpgt_epi32(lane, _mm_set1_epi32(x0 - 1)),
+                                               _mm_cmplt_epi32(lane, _mm_set1_epi32(x1 + 1)));
+                __m128 hidden = _mm_cmplt_ps(_mm_loadu_ps(row + x), z);
+                // a pixel in range that is not nearer than the box means it may show
+                if (_mm_movemask_ps(_mm_andnot_ps(hidden, _mm_castsi128_ps(inside)))) return false;
+            }
+#else
+            for (int x = x0; x <= x1; x++)
+                if (!(row[x] < zNear)) return false;
+#endif
+        }
+        return true;
+    }
+
+private:
+    glm::mat4 vp = glm::mat4(1.0f);
+    int height = 0;
+    std::vector<float> depth;            // window depth in [0, 1], 1 = far
+    std::vector<glm::vec3> screen;       // per-mesh scratch, reused
+    std::vector<char> clipped;
+
+    // Clip space to buffer pixels (x, y) and window depth z; false if behind the near plane.
+    bool project(const glm::vec4 &c, glm::vec3 &p) const {
+        if (c.w <= 1e-5f || c.z < -c.w) return false;
+        float inv = 1.0f / c.w;
+        p = glm::vec3((c.x * inv * 0.5f + 0.5f) * kWidth, (c.y * inv * 0.5f + 0.5f) * height, c.z * inv * 0.5f + 0.5f);
+        return true;
+    }
+
+    void triangle(glm::vec3 a, glm::vec3 b, glm::vec3 c) {
+        float area = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+        if (std::fabs(area) < 1e-8f) return;
+        if (area < 0.0f) { std::swap(b, c); area = -area; }
+
+        int x0 = std::max(0, (int)std::floor(std::min({a.x, b.x, c.x})));
+        int x1 = std::min(kWidth - 1, (int)std::floor(std::max({a.x, b.x, c.x})));
+        int y0 = std::max(0, (int)std::floor(std::min({a.y, b.y, c.y})));
+        int y1 = std::min(height - 1, (int)std::floor(std::max({a.y, b.y, c.y})));
+        if (x0 > x1 || y0 > y1) return;
+
+        // Edge functions E = A x + B y + C, positive inside. Requiring E >= (|A| + |B|) / 2
+        // at a pixel centre means the whole pixel is inside the edge.
+        const glm::vec3 *v[3] = {&a, &b, &c};
+        float A[3], B[3], C[3];
+        for (int e = 0; e < 3; e++) {
+            const glm::vec3 &p = *v[e], &q = *v[(e + 1) % 3];
+            A[e] = p.y - q.y;
+            B[e] = q.x - p.x;
+            C[e] = -(A[e] * p.x + B[e] * p.y) - 0.5f * (std::fabs(A[e]) + std::fabs(B[e]));
+        }
+        // Depth plane, biased to its farthest value within a pixel
+        float dzdx = ((b.z - a.z) * (c.y - a.y) - (c.z - a.z) * (b.y - a.y)) / area;
+        float dzdy = ((c.z - a.z) * (b.x - a.x) - (b.z - a.z) * (c.x - a.x)) / area;
+        float z0 = a.z - dzdx * a.x - dzdy * a.y + 0.5f * (std::fabs(dzdx) + std::fabs(dzdy));
+
+        for (int y = y0; y <= y1; y++) {
+            float py = y + 0.5f;
+            float *row = &depth[(size_t)y * kWidth];
+#if defined(__SSE2__)
+            __m128 rowE0 = _mm_set1_ps(B[0] * py + C[0]), rowE1 = _mm_set1_ps(B[1] * py + C[1]), rowE2 = _mm_set1_ps(B[2] * py + C[2]);
+            __m128 a0 = _mm_set1_ps(A[0]), a1 = _mm_set1_ps(A[1]), a2 = _mm_set1_ps(A[2]);
+            __m128 rowZ = _mm_set1_ps(z0 + dzdy * py), dz = _mm_set1_ps(dzdx), zero = _mm_setzero_ps();
+            for (int x = x0 & ~3; x <= x1; x += 4) {
+                __m128 px = _mm_add_ps(_mm_set1_ps((float)x), _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f));
+                __m128 in = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a0, px), rowE0), zero),
+                                                  _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a1, px), rowE1), zero)),
+                                       _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a2, px), rowE2), zero));
+                if (!_mm_movemask_ps(in)) continue;
+                __m128 old = _mm_loadu_ps(row + x);
+                __m128 z = _mm_min_ps(old, _mm_add_ps(rowZ, _mm_mul_ps(dz, px)));
+                _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(in, z), _mm_andnot_ps(in, old)));
+            }
+#else
+            for (int x = x0; x <= x1; x++) {
+                float px = x + 0.5f;
+                if (A[0] * px + B[0] * py + C[0] < 0.0f || A[1] * px + B[1] * py + C[1] < 0.0f ||
+                    A[2] * px + B[2] * py + C[2] < 0.0f) continue;
+                row[x] = std::min(row[x], z0 + dzdx * px + dzdy * py);
+            }
+#endif
+        }
+    }
+};
+
+// Culls a draw list in place, keeping its order. Occluders are the items whose
+// bounds cover the most of the screen, up to maxOccluders of them; items are
+// tested by their world bounds. Scratch storage is kept between frames.
+class OcclusionCuller {
+public:
+    size_t maxOccluders = 32;
+    float minOccluderArea = 0.002f;      // fraction of the screen a bound must cover to be an occluder
+
+    size_t occluders = 0;                // last frame's statistics
+    size_t culled = 0;
+
+    void cull(DrawList &list, const glm::mat4 &viewProjection, float aspect) {
+        buffer.begin(viewProjection, aspect);
+        size_t n = list.items.size();
+        rects.resize(n);
+        inFront.resize(n);
+        candidates.clear();
+        for (size_t i = 0; i < n; i++) {
+            const DrawItem &item = list.items[i];
+            inFront[i] = buffer.project(transformBounds(item.matrix, unitBounds(item.type)), rects[i]);
+            if (!inFront[i]) continue;
+            float area = buffer.coverage(rects[i]);
+            if (area >= minOccluderArea) candidates.push_back({area, (uint32_t)i});
+        }
+        if (candidates.size() > maxOccluders) {
+            std::nth_element(candidates.begin(), candidates.begin() + maxOccluders, candidates.end(),
+                             [](const Candidate &a, const Candidate &b) { return a.area > b.area; });
+            candidates.resize(maxOccluders);
+        }
+        for (const Candidate &c : candidates) {
+            const DrawItem &item = list.items[c.index];
+            buffer.rasterize(unitMesh(item.type, 1), item.matrix);
+        }
+        occluders = candidates.size();
+
+        size_t kept = 0;
+        for (size_t i = 0; i < n; i++) {
+            if (inFront[i] && buffer.occluded(rects[i])) continue;
+            if (kept != i) list.items[kept] = std::move(list.items[i]);
+            kept++;
+        }
+        culled = n - kept;
+        list.items.resize(kept);
+    }
+
+private:
+    struct Candidate { float area; uint32_t index; };
+    OcclusionBuffer buffer;
+    std::vector<OcclusionBuffer::ScreenRect> rects;
+    std::vector<char> inFront;
+    std::vector<Candidate> candidates;
+};
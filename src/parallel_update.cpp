@@ -0,0 +1,168 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "hnode.cpp"
+#include "bounds.cpp"
+#include "thread_pool.cpp"
+
+// Process-wide pool shared by the hierarchy update and other bulk jobs.
+inline WorkStealingPool& sharedPool() {
+    static WorkStealingPool pool;
+    return pool;
+}
+
+// One flag per run of 2^kShift consecutive nodes. Any thread may set a flag;
+// the consumer clears them after it has caught up (see ModelBounds).
+class ChunkFlags {
+public:
+    static const size_t kShift = 12;   // 4096 nodes per chunk
+
+    ChunkFlags() = default;
+    ChunkFlags(const ChunkFlags &o) { *this = o; }
+    ChunkFlags& operator=(const ChunkFlags &o) {
+        if (this == &o) return *this;
+        n = o.n;
+        flags.reset(n ? new std::atomic<uint8_t>[n] : nullptr);
+        for (size_t c = 0; c < n; c++) flags[c].store(o.flags[c].load(std::memory_order_relaxed), std::memory_order_relaxed);
+        return *this;
+    }
+
+    // Sized for `nodes` nodes, every chunk set.
+    void reset(size_t nodes) {
+        size_t chunks = (nodes + (size_t(1) << kShift) - 1) >> kShift;
+        if (chunks != n) { n = chunks; flags.reset(n ? new std::atomic<uint8_t>[n] : nullptr); }
+        for (size_t c = 0; c < n; c++) flags[c].store(1, std::memory_order_relaxed);
+    }
+
+    size_t chunks() const { return n; }
+    void mark(size_t node) { flags[node >> kShift].store(1, std::memory_order_relaxed); }
+    bool test(size_t chunk) const { return flags[chunk].load(std::memory_order_relaxed) != 0; }
+    void clear(size_t chunk) { flags[chunk].store(0, std::memory_order_relaxed); }
+
+private:
+    std::unique_ptr<std::atomic<uint8_t>[]> flags;
+    size_t n = 0;
+};
+
+// The HNode tree flattened in pre-order into parallel arrays, with INSTANCE
+// nodes expanded (a shared HNode appears once per instance).
+// A node's subtree is the contiguous range [i, i + subtreeSize[i]), and every
+// parent comes before its children, so any such range can be updated front to
+// back on its own once the parent of its first node is known.
+struct FlatHierarchy {
+    std::vector<HNode*> nodes;
+    std::vector<Shape*> shapes;           // nullptr for pure grouping nodes
+    std::vector<int> parent;              // -1 for the root
+    std::vector<uint32_t> subtreeSize;    // including the node itself
+    std::vector<glm::mat4> world;
+    std::vector<AABB> bounds;             // world bounds of the node's own shape
+    ChunkFlags boundsChanged;             // chunks where `bounds` changed since last cleared
+
+    size_t size() const { return nodes.size(); }
+
+    void build(HNode *root) {
+        nodes.clear(); shapes.clear(); parent.clear(); subtreeSize.clear();
+        if (root) {
+            // Explicit stack: hierarchies can be far deeper than the call stack allows.
+            std::vector<std::pair<HNode*, int>> stack;
+            stack.push_back({root, -1});
+            while (!stack.empty()) {
+                auto [node, p] = stack.back();
+                stack.pop_back();
+                int index = (int)nodes.size();
+                nodes.push_back(node);
+                shapes.push_back(node->getShape().get());
+                parent.push_back(p);
+                // an instance expands its shared definition here, once per use
+                if (auto &def = node->getInstance()) stack.push_back({def.get(), index});
+                const auto &children = node->getChildren();
+                for (auto it = children.rbegin(); it != children.rend(); ++it)
+                    if (*it) stack.push_back({it->get(), index});
+            }
+        }
+        subtreeSize.assign(nodes.size(), 1);
+        for (size_t i = nodes.size(); i-- > 1;) subtreeSize[parent[i]] += subtreeSize[i];
+        world.resize(nodes.size());
+        bounds.resize(nodes.size());
+        boundsChanged.reset(nodes.size());
+    }
+};
+
+// Computes world matrices and bounds for a FlatHierarchy.
+// Small hierarchies are walked serially. Larger ones are cut into contiguous
+// pre-order ranges of roughly `grain` nodes that run as tasks on the pool; each
+// task writes only its own slots, so there are no locks and no atomics on the
+// output. Every world matrix is the same parent * local product in the same
+// order as the serial walk, so both paths give bit-identical results.
+class HierarchyUpdater {
+public:
+    explicit HierarchyUpdater(WorkStealingPool *pool = &sharedPool(), size_t serialThreshold = 8192, size_t grain = 2048)
+        : pool(pool), serialThreshold(serialThreshold), grain(grain) {}
+
+    void update(FlatHierarchy &h) {
+        if (!pool || h.size() < serialThreshold) { updateSerial(h); return; }
+        TaskGroup group;
+        split(h, 0, group);
+        pool->wait(group);
+    }
+
+    void updateSerial(FlatHierarchy &h) { updateRange(h, 0, h.size()); }
+
+private:
+    WorkStealingPool *pool;
+    size_t serialThreshold;
+    size_t grain;
+
+    static void updateNode(FlatHierarchy &h, size_t i) {
+        const glm::mat4 &local = h.nodes[i]->getLocalMatrix();
+        int p = h.parent[i];
+        h.world[i] = (p < 0) ? local : h.world[p] * local;
+        AABB b = h.shapes[i] ? transformBounds(h.world[i], unitBounds(h.shapes[i]->shapetype)) : AABB();
+        if (b.min != h.bounds[i].min || b.max != h.bounds[i].max) {
+            h.bounds[i] = b;
+            h.boundsChanged.mark(i);
+        }
+    }
+
+    static void updateRange(FlatHierarchy &h, size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) updateNode(h, i);
+    }
+
+    // Node i has not been computed yet but its parent has.
+    void split(FlatHierarchy &h, size_t i, TaskGroup &group) {
+        size_t end = i + h.subtreeSize[i];
+        if (h.subtreeSize[i] <= grain) {
+            submitRange(h, i, end, group);
+            return;
+        }
+        updateNode(h, i);
+
+        // Consecutive small children are batched into one range; wide assembly
+        // nodes with thousands of leaves end up as a handful of even tasks.
+        size_t groupBegin = i + 1;
+        size_t child = i + 1;
+        while (child < end) {
+            size_t s = h.subtreeSize[child];
+            if (s > grain) {
+                if (groupBegin < child) submitRange(h, groupBegin, child, group);
+                pool->submit(group, [this, &h, child, &group] { split(h, child, group); });
+                groupBegin = child + s;
+            } else if (child + s - groupBegin >= grain) {
+                submitRange(h, groupBegin, child + s, group);
+                groupBegin = child + s;
+            }
+            child += s;
+        }
+        if (groupBegin < end) submitRange(h, groupBegin, end, group);
+    }
+
+    void submitRange(FlatHierarchy &h, size_t begin, size_t end, TaskGroup &group) {
+        pool->submit(group, [&h, begin, end] { updateRange(h, begin, end); });
+    }
+};
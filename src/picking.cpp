@@ -0,0 +1,142 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <cmath>
+#include <vector>
+
+#include "bvh.cpp"
+
+// --- Ray-cast picking ---
+// Candidates come from a BVH over world bounds; each is confirmed with an exact
+// ray test against the analytic primitive (not its tessellation), done in the
+// primitive's unit space so one test per type covers every transform.
+
+struct Ray {
+    glm::vec3 origin;
+    glm::vec3 dir;
+};
+
+// Ray through a cursor position given in window pixels (origin top-left).
+inline Ray rayFromCursor(double x, double y, int width, int height, const glm::mat4 &view, const glm::mat4 &projection) {
+    float nx = float(2.0 * x / width - 1.0);
+    float ny = float(1.0 - 2.0 * y / height);
+    glm::mat4 inv = glm::inverse(projection * view);
+    glm::vec4 nearPoint = inv * glm::vec4(nx, ny, -1.0f, 1.0f);
+    glm::vec4 farPoint = inv * glm::vec4(nx, ny, 1.0f, 1.0f);
+    glm::vec3 a = glm::vec3(nearPoint) / nearPoint.w;
+    glm::vec3 b = glm::vec3(farPoint) / farPoint.w;
+    return {a, glm::normalize(b - a)};
+}
+
+// Smallest root of a t^2 + b t + c = 0 in (tMin, tMax), if any.
+inline bool nearestRoot(float a, float b, float c, float tMin, float tMax, float &t) {
+    if (std::fabs(a) < 1e-12f) {
+        if (std::fabs(b) < 1e-12f) return false;
+        t = -c / b;
+        return t > tMin && t < tMax;
+    }
+    float disc = b * b - 4.0f * a * c;
+    if (disc < 0.0f) return false;
+    float s = std::sqrt(disc);
+    float t0 = (-b - s) / (2.0f * a), t1 = (-b + s) / (2.0f * a);
+    if (t0 > t1) std::swap(t0, t1);
+    if (t0 > tMin && t0 < tMax) { t = t0; return true; }
+    if (t1 > tMin && t1 < tMax) { t = t1; return true; }
+    return false;
+}
+
+// Exact hit against the unit primitive (shapes as in unitBounds()). o and d are the
+// ray in unit space; d is deliberately not normalised, so t is the same parameter
+// as along the world ray. Only hits with t in (0, tBest) count; tBest is lowered.
+inline bool rayHitsUnitPrimitive(ShapeType type, const glm::vec3 &o, const glm::vec3 &d, float &tBest) {
+    const float eps = 1e-6f;
+    float t = 0.0f;
+    bool hit = false;
+    auto accept = [&](float c) { if (c > eps && c < tBest) { tBest = c; hit = true; } };
+    // flat disc of radius 1 in the plane y = h
+    auto cap = [&](float h) {
+        if (std::fabs(d.y) < 1e-12f) return;
+        float c = (h - o.y) / d.y;
+        glm::vec3 p = o + c * d;
+        if (p.x * p.x + p.z * p.z <= 1.0f) accept(c);
+    };
+
+    switch (type) {
+    case ShapeType::SPHERE_SHAPE:
+        if (nearestRoot(glm::dot(d, d), 2.0f * glm::dot(o, d), glm::dot(o, o) - 1.0f, eps, tBest, t)) accept(t);
+        break;
+    case ShapeType::BOX_SHAPE: {
+        glm::vec3 inv(1.0f / d.x, 1.0f / d.y, 1.0f / d.z);
+        AABB unit = unitBounds(type);
+        float tNear;
+        if (BVH::rayBox(unit, o, inv, tBest, tNear)) {
+            if (tNear > eps) accept(tNear);
+            else {
+                // starting inside: take the exit point
+                glm::vec3 t0 = (unit.min - o) * inv, t1 = (unit.max - o) * inv, hi = glm::max(t0, t1);
+                accept(std::min(std::min(hi.x, hi.y), hi.z));
+            }
+        }
+        break;
+    }
+    case ShapeType::CYLINDER_SHAPE:
+        // side x^2 + z^2 = 1 for |y| <= 0.5, then both caps
+        if (nearestRoot(d.x * d.x + d.z * d.z, 2.0f * (o.x * d.x + o.z * d.z), o.x * o.x + o.z * o.z - 1.0f, eps, tBest, t)) {
+            float y = o.y + t * d.y;
+            if (y >= -0.5f && y <= 0.5f) accept(t);
+        }
+        cap(-0.5f);
+        cap(0.5f);
+        break;
+    case ShapeType::CONE_SHAPE: {
+        // side x^2 + z^2 = (1 - y)^2 for 0 <= y <= 1, then the base
+        float k = 1.0f - o.y;
+        float a = d.x * d.x + d.z * d.z - d.y * d.y;
+        float b = 2.0f * (o.x * d.x + o.z * d.z + k * d.y);
+        float c = o.x * o.x + o.z * o.z - k * k;
+        // the quadratic also describes the mirrored cone above the apex; try both roots
+        for (int pass = 0; pass < 2 && nearestRoot(a, b, c, pass ? t : eps, tBest, t); pass++) {
+            float y = o.y + t * d.y;
+            if (y >= 0.0f && y <= 1.0f) { accept(t); break; }
+        }
+        cap(0.0f);
+        break;
+    }
+    }
+    return hit;
+}
+
+// Exact hit for a primitive with a world transform; see rayHitsUnitPrimitive.
+inline bool rayHitsPrimitive(ShapeType type, const glm::mat4 &world, const Ray &ray, float &tBest) {
+    glm::mat4 inv = glm::inverse(world);
+    glm::vec3 o = glm::vec3(inv * glm::vec4(ray.origin, 1.0f));
+    glm::vec3 d = glm::vec3(inv * glm::vec4(ray.dir, 0.0f));
+    return rayHitsUnitPrimitive(type, o, d, tBest);
+}
+
+// Picks among a set of primitives given per item as type, world matrix and world bounds.
+// rebuild() is O(n log n) and only needed after items move; pick() is logarithmic
+// in the item count plus the exact tests on the few candidates the BVH returns.
+class Picker {
+public:
+    void rebuild(const std::vector<AABB> &bounds) { bvh.build(bounds); }
+
+    bool empty() const { return bvh.empty(); }
+
+    // shapeAt(i, type, world) fills in item i's primitive type and world matrix, or
+    // returns false to skip it. Returns the nearest hit item, or -1; tHit gets its
+    // distance along the ray.
+    template <typename ShapeAt>
+    int pick(const Ray &ray, ShapeAt shapeAt, float &tHit) const {
+        tHit = INFINITY;
+        return bvh.raycast(ray.origin, ray.dir, tHit, [&](uint32_t i, float &tBest) {
+            ShapeType type;
+            const glm::mat4 *world;
+            if (!shapeAt(i, type, world)) return false;
+            return rayHitsPrimitive(type, *world, ray, tBest);
+        });
+    }
+
+private:
+    BVH bvh;
+};
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "frame_pipeline.cpp"
+#include "unit_mesh.cpp"
+
+// --- Bufferless primitives ---
+// Drop-in alternative to MeshBuffer that keeps no geometry at all. The vertex
+// shader (shaders/procedural_vshader.glsl) computes every vertex of a unit mesh
+// from gl_VertexID, the primitive and the level, and each draw call covers up
+// to kBatch nodes of one mesh, their matrices and colours passed in uniform
+// arrays that gl_InstanceID indexes. Nothing is tessellated, uploaded or kept
+// on the GPU, so every level, up to kMaxTessellationLevel, is there on the
+// first frame.
+//
+// The price is vertex work: triangles share no vertices, so each grid vertex
+// is computed about six times instead of once. That is cheap for the level 1-4
+// meshes most models use and is what close-ups of levels 5-8 trade for not
+// building million-triangle meshes.
+class ProceduralRenderer {
+public:
+    static const int kBatch = 48;   // array size in the shader; 5 vec4 each stays within GL 3.3's 256
+
+    ~ProceduralRenderer() {
+        if (vao) glDeleteVertexArrays(1, &vao);
+    }
+
+    // Vertices drawn per instance: three per triangle, none shared.
+    static GLsizei vertexCount(ShapeType type, unsigned int level) {
+        return (GLsizei)(3 * unitTriangleCount(type, clampLevel(level)));
+    }
+
+    // Submits a frame's draw list. `program` is procedural_vshader/fshader, in use.
+    void submit(const DrawList &list, GLuint program, const glm::mat4 &viewProjection) {
+        // a core profile context draws nothing without a VAO, even one with no attributes
+        if (!vao) glGenVertexArrays(1, &vao);
+        glBindVertexArray(vao);
+        if (program != boundProgram) lookupUniforms(program);
+        // items are sorted by mesh key, so a batch is a run of equal keys
+        uint32_t key = ~0u;
+        for (const DrawItem &item : list.items) {
+            if (item.key != key || pending == kBatch) {
+                flush();
+                key = item.key;
+                type = item.type;
+                level = clampLevel(item.level);
+            }
+            matrices[pending] = viewProjection * item.matrix;
+            colors[pending++] = item.color;
+        }
+        flush();
+        glBindVertexArray(0);
+    }
+
+private:
+    GLuint vao = 0;
+    GLuint boundProgram = 0;
+    GLint shapeLocation = -1, divisionsLocation = -1, mvpLocation = -1, colorLocation = -1;
+    ShapeType type = ShapeType::SPHERE_SHAPE;
+    unsigned int level = 1;
+    int pending = 0;
+    glm::mat4 matrices[kBatch];
+    glm::vec4 colors[kBatch];
+
+    // The shader's own numbering, independent of the ShapeType enum's order.
+    static int shaderShape(ShapeType t) {
+        switch (t) {
+            case ShapeType::SPHERE_SHAPE:   return 0;
+            case ShapeType::CYLINDER_SHAPE: return 1;
+            case ShapeType::BOX_SHAPE:      return 2;
+            case ShapeType::CONE_SHAPE:     return 3;
+        }
+        return 0;
+    }
+
+    void flush() {
+        if (!pending) return;
+        glUniform1i(shapeLocation, shaderShape(type));
+        glUniform1i(divisionsLocation, 1 << (level - 1));
+        glUniformMatrix4fv(mvpLocation, pending, GL_FALSE, glm::value_ptr(matrices[0]));
+        glUniform4fv(colorLocation, pending, glm::value_ptr(colors[0]));
+        glDrawArraysInstanced(GL_TRIANGLES, 0, vertexCount(type, level), pending);
+        pending = 0;
+    }
+
+    void lookupUniforms(GLuint program) {
+        shapeLocation = glGetUniformLocation(program, "shape");
+        divisionsLocation = glGetUniformLocation(program, "divisions");
+        mvpLocation = glGetUniformLocation(program, "ModelViewProjectMatrices");
+        colorLocation = glGetUniformLocation(program, "colors");
+        boundProgram = program;
+    }
+};
@@ -0,0 +1,233 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "model.cpp"
+#include "bounds.cpp"
+#include "parallel_update.cpp"
+#include "undo_history.cpp"
+
+// --- Selection sets and batched transforms ---
+// A selection is a sorted list of indices into a model's FlatHierarchy.
+// Queries pick nodes by shape type, colour, world region or subtree, scanning
+// in parallel; named sets keep the result so it can be edited repeatedly. A
+// TransformStep is then applied to the whole set in one parallel pass: one
+// undo step and one world update, however many nodes move.
+
+using Selection = std::vector<uint32_t>;
+
+// One increment of the modelling keys: rotate by degrees, translate by units
+// or scale by a factor, along one axis ('X', 'Y' or 'Z').
+struct TransformStep {
+    enum Kind { ROTATE, TRANSLATE, SCALE } kind = ROTATE;
+    char axis = 'X';
+    float amount = 0.0f;
+
+    // Changes a node's local transform; only touches the node itself, so the
+    // caller decides when to report the change (see HNode::setTransform).
+    void apply(HNode &n, bool notify) const {
+        glm::vec3 t = n.getTranslation(), r = n.getRotation(), s = n.getScale();
+        int a = axis - 'X';
+        if (kind == ROTATE) r[a] += amount;
+        else if (kind == TRANSLATE) t[a] += amount;
+        else s[a] *= amount;
+        n.setTransform(t, r, s, notify);
+    }
+};
+
+// What a named set selects. Written as text at the prompt and in logs:
+//
+//   type sphere|cylinder|box|cone
+//   color R G B [TOLERANCE]              each channel within TOLERANCE (default 0.01)
+//   region X0 Y0 Z0 X1 Y1 Z1             world bounds overlap the box
+//   subtree N                            node N and everything below it (hierarchies only)
+//   all
+struct SelectionQuery {
+    enum Kind { ALL, TYPE, COLOR, REGION, SUBTREE } kind = ALL;
+    ShapeType type = ShapeType::SPHERE_SHAPE;
+    glm::vec3 color = glm::vec3(0.0f);
+    float tolerance = 0.01f;
+    AABB region;
+    uint32_t root = 0;
+
+    static bool parse(const std::string &text, SelectionQuery &q, std::string &error) {
+        std::istringstream in(text);
+        std::string word;
+        in >> word;
+        std::transform(word.begin(), word.end(), word.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+        q = SelectionQuery();
+        if (word == "all") {
+            q.kind = ALL;
+        } else if (word == "type") {
+            std::string name;
+            in >> name;
+            std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return (char)std::toupper(c); });
+            q.kind = TYPE;
+            if (name == "SPHERE") q.type = ShapeType::SPHERE_SHAPE;
+            else if (name == "CYLINDER") q.type = ShapeType::CYLINDER_SHAPE;
+            else if (name == "BOX") q.type = ShapeType::BOX_SHAPE;
+            else if (name == "CONE") q.type = ShapeType::CONE_SHAPE;
+            else { error = "unknown shape type '" + name + "'"; return false; }
+        } else if (word == "color" || word == "colour") {
+            q.kind = COLOR;
+            if (!(in >> q.color.x >> q.color.y >> q.color.z)) { error = "expected color R G B [TOLERANCE]"; return false; }
+            if (!(in >> q.tolerance)) q.tolerance = 0.01f;
+        } else if (word == "region") {
+            q.kind = REGION;
+            if (!(in >> q.region.min.x >> q.region.min.y >> q.region.min.z >> q.region.max.x >> q.region.max.y >> q.region.max.z)) {
+                error = "expected region X0 Y0 Z0 X1 Y1 Z1";
+                return false;
+            }
+            AABB box = q.region;
+            q.region.min = glm::min(box.min, box.max);
+            q.region.max = glm::max(box.min, box.max);
+        } else if (word == "subtree") {
+            q.kind = SUBTREE;
+            if (!(in >> q.root)) { error = "expected subtree N"; return false; }
+        } else {
+            error = "expected all, type, color, region or subtree";
+            return false;
+        }
+        return true;
+    }
+
+    // Whether a shape with this type, colour and world bounds is selected
+    // (SUBTREE is a range, see selectNodes()).
+    bool matches(const Shape &s, const AABB &bounds) const {
+        switch (kind) {
+            case ALL: return true;
+            case TYPE: return s.shapetype == type;
+            case COLOR: {
+                glm::vec3 d = glm::abs(s.getColor() - color);
+                return d.x <= tolerance && d.y <= tolerance && d.z <= tolerance;
+            }
+            case REGION:
+                return bounds.min.x <= region.max.x && bounds.max.x >= region.min.x &&
+                       bounds.min.y <= region.max.y && bounds.max.y >= region.min.y &&
+                       bounds.min.z <= region.max.z && bounds.max.z >= region.min.z;
+            case SUBTREE: return false;
+        }
+        return false;
+    }
+};
+
+// Indices in [0, count) for which match(i) holds, in order. Chunks are scanned
+// in parallel and their results concatenated.
+template <typename Match>
+Selection selectWhere(size_t count, Match match, WorkStealingPool *pool = &sharedPool(), size_t grain = 16384) {
+    if (!pool || count <= grain) {
+        Selection out;
+        for (size_t i = 0; i < count; i++) if (match(i)) out.push_back((uint32_t)i);
+        return out;
+    }
+    std::vector<Selection> parts((count + grain - 1) / grain);
+    pool->parallelFor(0, parts.size(), 1, [&](size_t begin, size_t end) {
+        for (size_t c = begin; c < end; c++)
+            for (size_t i = c * grain; i < std::min(count, (c + 1) * grain); i++)
+                if (match(i)) parts[c].push_back((uint32_t)i);
+    });
+    Selection out;
+    size_t total = 0;
+    for (auto &p : parts) total += p.size();
+    out.reserve(total);
+    for (auto &p : parts) out.insert(out.end(), p.begin(), p.end());
+    return out;
+}
+
+// Over a flattened hierarchy whose world bounds are current. Grouping nodes
+// are selected only by ALL and SUBTREE.
+inline Selection selectNodes(const FlatHierarchy &h, const SelectionQuery &q, WorkStealingPool *pool = &sharedPool()) {
+    if (q.kind == SelectionQuery::SUBTREE) {
+        Selection out;
+        if (q.root >= h.size()) return out;
+        out.resize(h.subtreeSize[q.root]);
+        for (size_t k = 0; k < out.size(); k++) out[k] = q.root + (uint32_t)k;
+        return out;
+    }
+    return selectWhere(h.size(), [&](size_t i) {
+        if (!h.shapes[i]) return q.kind == SelectionQuery::ALL;
+        return q.matches(*h.shapes[i], h.bounds[i]);
+    }, pool);
+}
+
+// Applies `step` to the nodes of model.hierarchy() at the selected indices,
+// which must come from the hierarchy as it is after updateWorld() (indices
+// past its end are ignored).
+// Selected nodes below another selected node already move with it and are
+// left alone, and a shared (instanced) node is moved once, however many times
+// it appears. The nodes are updated in parallel and reported with a single
+// generation bump, so the next frame runs one world update (and one bounds
+// update) for all of them. With a history, that is one undo step.
+inline void applyTransform(Model &model, const Selection &selection, const TransformStep &step,
+                           EditHistory *history = nullptr, WorkStealingPool *pool = &sharedPool()) {
+    if (selection.empty()) return;
+    model.updateWorld();   // flattens again if the tree changed, so h.nodes are live
+    const FlatHierarchy &h = model.hierarchy();
+    std::vector<HNode*> nodes;
+    size_t coveredEnd = 0;   // end of the subtree of the last node kept
+    for (uint32_t i : selection) {
+        if (i >= h.size()) break;
+        if (i < coveredEnd) continue;
+        nodes.push_back(h.nodes[i]);
+        coveredEnd = i + h.subtreeSize[i];
+    }
+    std::sort(nodes.begin(), nodes.end());
+    nodes.erase(std::unique(nodes.begin(), nodes.end()), nodes.end());
+    if (history) history->modifyAll(nodes, pool);
+    auto apply = [&](size_t begin, size_t end) {
+        for (size_t k = begin; k < end; k++) step.apply(*nodes[k], false);
+    };
+    if (pool && nodes.size() > 1024) pool->parallelFor(0, nodes.size(), 1024, apply);
+    else apply(0, nodes.size());
+    HNode::transformsChanged();
+}
+
+// Named selections over a model's nodes. A set is evaluated when it is
+// defined and keeps its nodes while they are edited (a region set does not
+// lose the shapes it moves out of the region); once nodes are added or
+// removed, its query is run again on first use.
+class SelectionSets {
+public:
+    void define(const std::string &name, const SelectionQuery &q, Model &model) {
+        model.updateWorld();
+        Entry &e = sets[name];
+        e.query = q;
+        e.selection = selectNodes(model.hierarchy(), q);
+        e.layoutVersion = model.layoutVersion();
+    }
+
+    bool contains(const std::string &name) const { return sets.count(name) != 0; }
+
+    // The nodes in set `name`, as indices into model.hierarchy(), or nullptr if
+    // there is no such set.
+    const Selection* get(const std::string &name, Model &model) {
+        auto it = sets.find(name);
+        if (it == sets.end()) return nullptr;
+        Entry &e = it->second;
+        model.updateWorld();
+        if (e.layoutVersion != model.layoutVersion()) {
+            e.selection = selectNodes(model.hierarchy(), e.query);
+            e.layoutVersion = model.layoutVersion();
+        }
+        return &e.selection;
+    }
+
+    void clear() { sets.clear(); }
+
+private:
+    struct Entry {
+        SelectionQuery query;
+        Selection selection;
+        uint64_t layoutVersion = 0;
+    };
+    std::map<std::string, Entry> sets;
+};
@@ -0,0 +1,291 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+// --- Shader loading ---
+
+inline bool readTextFile(const std::string &path, std::string &text) {
+    std::ifstream in(path);
+    if (!in) { std::cerr << "Cannot open shader " << path << "\n"; return false; }
+    std::stringstream ss;
+    ss << in.rdbuf();
+    text = ss.str();
+    return true;
+}
+
+inline GLuint compileShader(GLenum type, const std::string &source, const std::string &name) {
+    GLuint shader = glCreateShader(type);
+    const char *src = source.c_str();
+    glShaderSource(shader, 1, &src, nullptr);
+    glCompileShader(shader);
+    GLint ok = GL_FALSE;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &ok);
+    if (!ok) {
+        GLint len = 0;
+        glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &len);
+        std::vector<char> log(len + 1, '\0');
+        glGetShaderInfoLog(shader, len, nullptr, log.data());
+        std::cerr << "Failed to compile " << name << ":\n" << log.data() << "\n";
+        glDeleteShader(shader);
+        return 0;
+    }
+    return shader;
+}
+
+inline GLuint linkProgram(GLuint vs, GLuint fs) {
+    GLuint program = glCreateProgram();
+    glAttachShader(program, vs);
+    glAttachShader(program, fs);
+#ifdef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+    glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+#endif
+    glLinkProgram(program);
+    GLint ok = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &ok);
+    if (!ok) {
+        GLint len = 0;
+        glGetProgramiv(program, GL_INFO_LOG_LENGTH, &len);
+        std::vector<char> log(len + 1, '\0');
+        glGetProgramInfoLog(program, len, nullptr, log.data());
+        std::cerr << "Failed to link shader program:\n" << log.data() << "\n";
+        glDeleteProgram(program);
+        return 0;
+    }
+    return program;
+}
+
+// --- Program binary cache ---
+// Linked programs are kept on disk (glGetProgramBinary) so that a start-up
+// skips compiling and linking. Entries are keyed by a hash of both sources and
+// the driver's vendor, renderer and version strings; the driver string is also
+// stored in the file and compared, so neither a driver update nor a hash
+// collision can load a stale binary, and a binary the driver rejects anyway is
+// rebuilt from source and overwritten.
+//
+// The directory is $MODELLER_SHADER_CACHE, else $XDG_CACHE_HOME/modeller, else
+// ~/.cache/modeller; setting MODELLER_SHADER_CACHE to "" turns the cache off.
+// Needs GL 4.1 or ARB_get_program_binary in the loader (generate glad with the
+// extension); without it programs are always built from source.
+
+inline uint64_t fnv1a(const std::string &data, uint64_t h = 14695981039346656037ull) {
+    for (unsigned char c : data) { h ^= c; h *= 1099511628211ull; }
+    return h;
+}
+
+inline std::string shaderCacheDir() {
+    if (const char *dir = std::getenv("MODELLER_SHADER_CACHE")) return dir;
+    if (const char *xdg = std::getenv("XDG_CACHE_HOME")) if (*xdg) return std::string(xdg) + "/modeller";
+    if (const char *home = std::getenv("HOME")) if (*home) return std::string(home) + "/.cache/modeller";
+    return "";
+}
+
+inline std::string driverString() {
+    auto str = [](GLenum name) { const GLubyte *s = glGetString(name); return s ? std::string((const char*)s) : std::string(); };
+    return str(GL_VENDOR) + "|" + str(GL_RENDERER) + "|" + str(GL_VERSION);
+}
+
+// Cache file for this source pair on the current driver, or "" if there is no cache.
+inline std::string programCachePath(const std::string &vsSource, const std::string &fsSource, const std::string &driver) {
+#ifdef GL_NUM_PROGRAM_BINARY_FORMATS
+    GLint formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    std::string dir = shaderCacheDir();
+    if (formats <= 0 || dir.empty()) return "";
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.glprog",
+                  (unsigned long long)fnv1a(driver, fnv1a(fsSource, fnv1a(vsSource + '\0') ^ 0x9e3779b97f4a7c15ull)));
+    return dir + "/" + name;
+#else
+    (void)vsSource; (void)fsSource; (void)driver;
+    return "";
+#endif
+}
+
+// File layout: "MODPROG1", u32 driver length, driver string, u32 binary format,
+// u32 binary length, binary. Returns 0 on a miss.
+inline GLuint loadProgramBinary(const std::string &path, const std::string &driver) {
+#ifdef GL_NUM_PROGRAM_BINARY_FORMATS
+    std::ifstream in(path, std::ios::binary);
+    if (!in) return 0;
+    char magic[8] = {};
+    uint32_t driverLength = 0, format = 0, length = 0;
+    in.read(magic, 8);
+    in.read(reinterpret_cast<char*>(&driverLength), 4);
+    if (!in || std::string(magic, 8) != "MODPROG1" || driverLength != driver.size()) return 0;
+    std::string stored(driverLength, '\0');
+    in.read(&stored[0], driverLength);
+    in.read(reinterpret_cast<char*>(&format), 4);
+    in.read(reinterpret_cast<char*>(&length), 4);
+    if (!in || stored != driver || length == 0) return 0;
+    std::vector<char> binary(length);
+    if (!in.read(binary.data(), length)) return 0;
+
+    GLuint program = glCreateProgram();
+    glProgramBinary(program, (GLenum)format, binary.data(), (GLsizei)length);
+    GLint ok = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &ok);
+    if (!ok) { glDeleteProgram(program); return 0; }
+    return program;
+#else
+    (void)path; (void)driver;
+    return 0;
+#endif
+}
+
+// Written to a temporary file and renamed, so concurrent starts never read half a binary.
+inline void storeProgramBinary(GLuint program, const std::string &path, const std::string &driver) {
+#ifdef GL_NUM_PROGRAM_BINARY_FORMATS
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) return;
+    std::vector<char> binary(length);
+    GLenum format = 0;
+    glGetProgramBinary(program, length, &length, &format, binary.data());
+    if (length <= 0) return;
+
+    namespace fs = std::filesystem;
+    std::error_code ec;
+    fs::create_directories(fs::path(path).parent_path(), ec);
+    std::string tmp = path + ".XXXXXX";   // unique across processes and threads
+    int fd = mkstemp(&tmp[0]);
+    if (fd < 0) return;
+    close(fd);
+    {
+        std::ofstream out(tmp, std::ios::binary);
+        uint32_t driverLength = (uint32_t)driver.size(), format32 = format, length32 = (uint32_t)length;
+        out.write("MODPROG1", 8);
+        out.write(reinterpret_cast<const char*>(&driverLength), 4);
+        out.write(driver.data(), driver.size());
+        out.write(reinterpret_cast<const char*>(&format32), 4);
+        out.write(reinterpret_cast<const char*>(&length32), 4);
+        out.write(binary.data(), length);
+        if (!out) { out.close(); fs::remove(tmp, ec); return; }
+    }
+    fs::rename(tmp, path, ec);
+    if (ec) fs::remove(tmp, ec);
+#else
+    (void)program; (void)path; (void)driver;
+#endif
+}
+
+// Returns 0 (after printing why) if anything fails. Served from the program
+// binary cache when it has an entry for these sources on this driver.
+inline GLuint loadShaderProgram(const std::string &vsPath, const std::string &fsPath) {
+    std::string vsSource, fsSource;
+    if (!readTextFile(vsPath, vsSource) || !readTextFile(fsPath, fsSource)) return 0;
+    std::string driver = driverString();
+    std::string cachePath = programCachePath(vsSource, fsSource, driver);
+    if (!cachePath.empty())
+        if (GLuint program = loadProgramBinary(cachePath, driver)) return program;
+
+    GLuint vs = compileShader(GL_VERTEX_SHADER, vsSource, vsPath);
+    GLuint fs = compileShader(GL_FRAGMENT_SHADER, fsSource, fsPath);
+    GLuint program = (vs && fs) ? linkProgram(vs, fs) : 0;
+    if (vs) glDeleteShader(vs);
+    if (fs) glDeleteShader(fs);
+    if (program && !cachePath.empty()) storeProgramBinary(program, cachePath, driver);
+    return program;
+}
+
+// --- Hot reload ---
+// Watches a shader pair and rebuilds the program whenever either file changes.
+// The build runs on a thread of its own with a second GL context that shares
+// objects with the drawing one, so the frame loop never waits for the
+// compiler: poll(), once per frame on the drawing thread, only swaps in a
+// program that is already linked. A pair that fails to compile is reported and
+// the previous program stays in use.
+class ShaderReloader {
+public:
+    // useContext(true) makes the shared context current on the calling thread
+    // and useContext(false) releases it; both are called from the build thread.
+    // The initial program is built (or loaded from the cache) right away, on
+    // the calling thread.
+    ShaderReloader(const std::string &vsPath, const std::string &fsPath, std::function<void(bool)> useContext,
+                   std::chrono::milliseconds interval = std::chrono::milliseconds(250))
+        : vsPath(vsPath), fsPath(fsPath), useContext(std::move(useContext)), interval(interval) {
+        current = loadShaderProgram(vsPath, fsPath);
+        stamp = sourceStamp();
+        watcher = std::thread([this] { watchLoop(); });
+    }
+
+    ~ShaderReloader() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        watcher.join();
+        if (GLuint p = ready.exchange(0)) glDeleteProgram(p);
+        if (current) glDeleteProgram(current);
+    }
+
+    ShaderReloader(const ShaderReloader&) = delete;
+    ShaderReloader& operator=(const ShaderReloader&) = delete;
+
+    GLuint program() const { return current; }
+
+    // Returns true if program() changed; the old program is deleted.
+    bool poll() {
+        GLuint p = ready.exchange(0);
+        if (!p) return false;
+        if (current) glDeleteProgram(current);
+        current = p;
+        std::cout << "Reloaded " << vsPath << " / " << fsPath << "\n";
+        return true;
+    }
+
+private:
+    std::string vsPath, fsPath;
+    std::function<void(bool)> useContext;
+    std::chrono::milliseconds interval;
+    GLuint current = 0;
+    std::atomic<GLuint> ready{0};       // built, not yet swapped in
+    std::filesystem::file_time_type stamp;
+    std::thread watcher;
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool stopping = false;
+
+    // Newest modification time of the two files.
+    std::filesystem::file_time_type sourceStamp() const {
+        std::error_code ec;
+        auto a = std::filesystem::last_write_time(vsPath, ec);
+        auto b = std::filesystem::last_write_time(fsPath, ec);
+        return std::max(a, b);
+    }
+
+    void watchLoop() {
+        useContext(true);
+        std::unique_lock<std::mutex> lock(mutex);
+        while (!wake.wait_for(lock, interval, [this] { return stopping; })) {
+            auto now = sourceStamp();
+            if (now == stamp) continue;
+            stamp = now;
+            lock.unlock();
+            GLuint p = loadShaderProgram(vsPath, fsPath);
+            if (p) {
+                glFinish();   // complete before the drawing context binds it
+                if (GLuint stale = ready.exchange(p)) glDeleteProgram(stale);
+            }
+            lock.lock();
+        }
+        useContext(false);
+    }
+};
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <algorithm>
+#include <vector>
+
+#include "frame_pipeline.cpp"
+
+// --- Sphere impostors ---
+// Spheres that are small on screen are drawn as one quad each instead of a
+// mesh: the fragment shader (shaders/impostor_fshader.glsl) intersects the
+// pixel's ray with the unit sphere in object space and writes the exact depth,
+// so silhouettes and intersections with other shapes are those of the true
+// (possibly scaled, i.e. ellipsoidal) sphere rather than of a tessellation.
+// Two triangles replace the 256 of a level 1 sphere, and like
+// ProceduralRenderer no buffer is involved: quads come from gl_VertexID, up to
+// kBatch instances' matrices and colours from uniform arrays.
+//
+// Big spheres keep their meshes: writing gl_FragDepth turns off early depth
+// rejection and every pixel runs the ray cast, which costs more than the
+// triangles once a sphere covers much of the screen. So do spheres cut by the
+// near or far plane, which the quad cannot represent.
+class SphereImpostors {
+public:
+    static const int kBatch = 24;   // array size in the shader; 9 vec4 each stays within GL 3.3's 256
+
+    float maxPixels = 64.0f;        // largest screen extent drawn as an impostor
+    size_t drawn = 0;               // impostors in the last frame
+
+    ~SphereImpostors() {
+        if (vao) glDeleteVertexArrays(1, &vao);
+    }
+
+    // Moves the spheres to be drawn as impostors out of `list`; the rest keep
+    // their order. Reuses its storage, so steady-state frames do not allocate.
+    void take(DrawList &list, const glm::mat4 &viewProjection, int viewportWidth, int viewportHeight) {
+        instances.clear();
+        size_t kept = 0, n = list.items.size();
+        for (size_t i = 0; i < n; i++) {
+            DrawItem &item = list.items[i];
+            if (item.type == ShapeType::SPHERE_SHAPE) {
+                glm::mat4 mvp = viewProjection * item.matrix;
+                if (small(mvp, viewportWidth, viewportHeight)) { instances.push_back({mvp, item.color}); continue; }
+            }
+            if (kept != i) list.items[kept] = std::move(item);
+            kept++;
+        }
+        list.items.resize(kept);
+        drawn = instances.size();
+    }
+
+    // Draws what take() kept. `program` is impostor_vshader/impostor_fshader, in use.
+    void submit(GLuint program) {
+        if (instances.empty()) return;
+        // a core profile context draws nothing without a VAO, even one with no attributes
+        if (!vao) glGenVertexArrays(1, &vao);
+        glBindVertexArray(vao);
+        if (program != boundProgram) lookupUniforms(program);
+        for (size_t first = 0; first < instances.size(); first += kBatch) {
+            int count = (int)std::min<size_t>(kBatch, instances.size() - first);
+            for (int k = 0; k < count; k++) {
+                const Instance &s = instances[first + k];
+                matrices[k] = s.mvp;
+                inverses[k] = glm::inverse(s.mvp);
+                colors[k] = s.color;
+            }
+            glUniformMatrix4fv(mvpLocation, count, GL_FALSE, glm::value_ptr(matrices[0]));
+            glUniformMatrix4fv(inverseLocation, count, GL_FALSE, glm::value_ptr(inverses[0]));
+            glUniform4fv(colorLocation, count, glm::value_ptr(colors[0]));
+            glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, count);
+        }
+        glBindVertexArray(0);
+    }
+
+private:
+    struct Instance {
+        glm::mat4 mvp;
+        glm::vec4 color;
+    };
+    std::vector<Instance> instances;
+    GLuint vao = 0;
+    GLuint boundProgram = 0;
+    GLint mvpLocation = -1, inverseLocation = -1, colorLocation = -1;
+    glm::mat4 matrices[kBatch];
+    glm::mat4 inverses[kBatch];
+    glm::vec4 colors[kBatch];
+
+    // Whether the cube around the unit sphere lies between the near and far
+    // planes and spans at most maxPixels on screen, measured the same way the
+    // vertex shader sizes the quad.
+    bool small(const glm::mat4 &mvp, int viewportWidth, int viewportHeight) const {
+        float x0 = 1e30f, y0 = 1e30f, x1 = -1e30f, y1 = -1e30f;
+        for (int k = 0; k < 8; k++) {
+            glm::vec4 c = mvp * glm::vec4(k & 1 ? 1.0f : -1.0f, k & 2 ? 1.0f : -1.0f, k & 4 ? 1.0f : -1.0f, 1.0f);
+            if (c.w <= 0.0f || c.z < -c.w || c.z > c.w) return false;
+            float x = c.x / c.w, y = c.y / c.w;
+            x0 = std::min(x0, x); x1 = std::max(x1, x);
+            y0 = std::min(y0, y); y1 = std::max(y1, y);
+        }
+        return std::max((x1 - x0) * viewportWidth, (y1 - y0) * viewportHeight) * 0.5f <= maxPixels;
+    }
+
+    void lookupUniforms(GLuint program) {
+        mvpLocation = glGetUniformLocation(program, "ModelViewProjectMatrices");
+        inverseLocation = glGetUniformLocation(program, "inverseMatrices");
+        colorLocation = glGetUniformLocation(program, "colors");
+        boundProgram = program;
+    }
+};
@@ -0,0 +1,187 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+#include "parallel_update.cpp"
+#include "unit_mesh.cpp"
+
+// One baked subtree as a draw list carries it: a range of the baked index
+// buffer and the matrix to draw it with under the current world matrices.
+struct BakedDraw {
+    size_t firstIndex;
+    size_t indexCount;
+    glm::mat4 matrix;    // root's world matrix times the inverse of it at bake time
+};
+
+// Bakes static parts of the hierarchy into one merged vertex/index buffer.
+// Each baked subtree is stored in world space as it was at bake time and drawn
+// with a single glDrawElements whose matrix is the root's current world matrix
+// times the inverse of its matrix then; a rotation of the root (inspection
+// mode) costs one uniform update, not a rebake.
+// A subtree whose root matrix cannot be inverted (a zero scale, say) is left
+// unbaked and drawn shape by shape as in modelling mode.
+// Ranges are keyed on indices into the FlatHierarchy they were baked from, so
+// the bake must be made again once that is rebuilt (see Model::bakeCurrent).
+class StaticBaker {
+public:
+    ~StaticBaker() { release(); }
+
+    bool active() const { return !ranges.empty(); }
+
+    // Tells bakes apart, so a draw list made for an older one is not drawn
+    // from the new buffer; 0 when nothing is baked.
+    uint64_t id() const { return bakeId; }
+
+    // True if node i is the root of a baked subtree (the whole range is skipped).
+    bool covers(size_t i) const { return i < rangeOf.size() && rangeOf[i] >= 0; }
+
+    // The draw of the subtree rooted at node i, which covers(i).
+    BakedDraw drawOf(const FlatHierarchy &h, size_t i) const {
+        const BakedRange &r = ranges[rangeOf[i]];
+        return {r.firstIndex, r.indexCount, h.world[i] * r.bakeInverse};
+    }
+
+    // Bakes each top-level part (the children of a shapeless root, else the
+    // root) as its own subtree, so the inspection rotation of every part about
+    // its origin keeps it baked; or, if wholeModel is false, only the subtrees
+    // whose root is marked static. World matrices in h must be current.
+    void bake(const FlatHierarchy &h, bool wholeModel) {
+        release();
+        bakeId = ++bakes;
+        std::vector<BakedVertex> vertices;
+        std::vector<unsigned int> indices;
+        rangeOf.assign(h.size(), -1);
+        size_t degenerate = 0;
+
+        for (size_t i = 0; i < h.size();) {
+            bool part = i == 0 ? h.shapes[0] != nullptr : h.parent[i] == 0;
+            bool bakeHere = wholeModel ? part : h.nodes[i]->isStatic();
+            if (!bakeHere) { i++; continue; }
+
+            size_t end = i + h.subtreeSize[i];
+            if (!invertible(h.world[i])) { degenerate++; i = end; continue; }
+
+            BakedRange r;
+            r.node = i;
+            r.firstIndex = indices.size();
+            r.bakeInverse = glm::inverse(h.world[i]);
+            for (size_t j = i; j < end; j++) {
+                Shape *s = h.shapes[j];
+                if (!s) continue;
+                const UnitMesh &mesh = unitMesh(s->shapetype, s->level);
+                const glm::mat4 &m = h.world[j];
+                glm::vec4 color(s->getColor(), 1.0f);
+                unsigned int base = vertices.size();
+                for (auto &p : mesh.positions) vertices.push_back({m * glm::vec4(p, 1.0f), color});
+                for (auto idx : mesh.indices) indices.push_back(base + idx);
+            }
+            r.indexCount = indices.size() - r.firstIndex;
+            if (r.indexCount > 0) {
+                rangeOf[i] = (int)ranges.size();
+                ranges.push_back(r);
+            }
+            i = end;
+        }
+        if (degenerate) std::cout << degenerate << " static subtree(s) with a singular transform left unbaked.\n";
+        if (ranges.empty()) return;
+
+        glGenVertexArrays(1, &vao);
+        glGenBuffers(1, &vbo);
+        glGenBuffers(1, &ibo);
+        glBindVertexArray(vao);
+        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(BakedVertex), vertices.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+        glBindVertexArray(0);
+        boundProgram = 0;
+
+        std::cout << "Baked " << ranges.size() << " static subtree(s), "
+                  << indices.size() / 3 << " triangles.\n";
+    }
+
+    // Expects `program` to be the vshader/fshader pair and already in use.
+    void draw(const FlatHierarchy &h, GLuint program, const glm::mat4 &viewProjection) {
+        if (ranges.empty()) return;
+        glBindVertexArray(vao);
+        if (program != boundProgram) bindAttributes(program);
+        for (auto &r : ranges) drawRange(r.firstIndex, r.indexCount, viewProjection * h.world[r.node] * r.bakeInverse);
+        glBindVertexArray(0);
+    }
+
+    // Draws the baked subtrees of a draw list made for bake `id`, reading only
+    // the list. Nothing is drawn for another bake's list.
+    void draw(const std::vector<BakedDraw> &draws, uint64_t id, GLuint program, const glm::mat4 &viewProjection) {
+        if (draws.empty() || id != bakeId) return;
+        glBindVertexArray(vao);
+        if (program != boundProgram) bindAttributes(program);
+        for (auto &d : draws) drawRange(d.firstIndex, d.indexCount, viewProjection * d.matrix);
+        glBindVertexArray(0);
+    }
+
+    void release() {
+        if (vao) glDeleteVertexArrays(1, &vao);
+        if (vbo) glDeleteBuffers(1, &vbo);
+        if (ibo) glDeleteBuffers(1, &ibo);
+        vao = vbo = ibo = 0;
+        bakeId = 0;
+        ranges.clear();
+        rangeOf.clear();
+    }
+
+private:
+    struct BakedVertex {
+        glm::vec4 position;
+        glm::vec4 color;
+    };
+
+    struct BakedRange {
+        size_t node;
+        size_t firstIndex;
+        size_t indexCount;
+        glm::mat4 bakeInverse; // undoes the root's world matrix at bake time
+    };
+
+    std::vector<BakedRange> ranges;
+    std::vector<int> rangeOf;       // per node, the range rooted there or -1
+    uint64_t bakeId = 0;
+    inline static uint64_t bakes = 0;
+    GLuint vao = 0, vbo = 0, ibo = 0;
+    GLuint boundProgram = 0;
+    GLint mvpLocation = -1;
+
+    // Whether m's linear part is far enough from singular for the baked
+    // vertices to survive the round trip through its inverse: |det| against
+    // the product of the column lengths, its largest possible value (NaN fails).
+    static bool invertible(const glm::mat4 &m) {
+        glm::mat3 a(m);
+        float scale = glm::length(a[0]) * glm::length(a[1]) * glm::length(a[2]);
+        return std::abs(glm::determinant(a)) > 1e-6f * scale && scale > 0.0f;
+    }
+
+    void drawRange(size_t firstIndex, size_t indexCount, const glm::mat4 &mvp) {
+        glUniformMatrix4fv(mvpLocation, 1, GL_FALSE, glm::value_ptr(mvp));
+        glDrawElements(GL_TRIANGLES, (GLsizei)indexCount, GL_UNSIGNED_INT, (void*)(firstIndex * sizeof(unsigned int)));
+    }
+
+    void bindAttributes(GLuint program) {
+        GLint pos = glGetAttribLocation(program, "vPosition");
+        GLint col = glGetAttribLocation(program, "vColor");
+        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+        if (pos >= 0) {
+            glEnableVertexAttribArray(pos);
+            glVertexAttribPointer(pos, 4, GL_FLOAT, GL_FALSE, sizeof(BakedVertex), (void*)0);
+        }
+        if (col >= 0) {
+            glEnableVertexAttribArray(col);
+            glVertexAttribPointer(col, 4, GL_FLOAT, GL_FALSE, sizeof(BakedVertex), (void*)sizeof(glm::vec4));
+        }
+        mvpLocation = glGetUniformLocation(program, "ModelViewProjectMatrix");
+        boundProgram = program;
+    }
+};
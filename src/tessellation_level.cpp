@@ -0,0 +1,14 @@
+#pragma once
+
+#include <algorithm>
+
+// Finest tessellation level. Levels above 4 are for close-up inspection (a level 8
+// sphere has over four million triangles), so renderers build them in the
+// background and draw a coarser level until they are ready (see UnitMeshCache).
+// The shape classes only store their level; their geometry is the unit mesh
+// built for it (unit_mesh.cpp).
+const unsigned int kMaxTessellationLevel = 8;
+
+inline unsigned int clampLevel(unsigned int level) {
+    return std::min(std::max(level, 1u), kMaxTessellationLevel);
+}
@@ -0,0 +1,172 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Work-stealing thread pool.
+// Every worker owns a deque: it pushes and pops its own tasks at the back (LIFO,
+// so freshly split subtrees stay hot in its cache) and idle workers steal from
+// the front of other deques. The thread calling wait() helps out instead of
+// blocking. Tasks may submit further tasks but must not call wait() themselves.
+// Every task belongs to a TaskGroup, and wait(group) returns once that group's
+// tasks have finished. A task that throws still counts as finished; the first
+// exception of a group is rethrown from its wait().
+class WorkStealingPool;
+
+// One batch of tasks, with its own count of unfinished tasks and its own first
+// exception. Callers sharing a pool (the frame pipeline's worker and the UI
+// thread both use sharedPool()) thus wait only for, and only see the errors
+// of, the tasks they submitted themselves.
+class TaskGroup {
+public:
+    TaskGroup() = default;
+    TaskGroup(const TaskGroup&) = delete;
+    TaskGroup& operator=(const TaskGroup&) = delete;
+
+private:
+    friend class WorkStealingPool;
+    std::atomic<int> pending{0};
+    std::mutex errorMutex;
+    std::exception_ptr error;       // first exception thrown by a task since the last wait()
+};
+
+class WorkStealingPool {
+public:
+    explicit WorkStealingPool(unsigned int threadCount = std::thread::hardware_concurrency()) {
+        if (threadCount == 0) threadCount = 1;
+        for (unsigned int i = 0; i < threadCount; i++) queues.push_back(std::make_unique<Queue>());
+        for (unsigned int i = 0; i < threadCount; i++) workers.emplace_back([this, i] { workerLoop(i); });
+    }
+
+    ~WorkStealingPool() {
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto &w : workers) w.join();
+    }
+
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    unsigned int size() const { return (unsigned int)workers.size(); }
+
+    // Tasks submitted from a worker go to its own deque, others are spread round-robin.
+    void submit(TaskGroup &group, std::function<void()> task) {
+        group.pending.fetch_add(1, std::memory_order_relaxed);
+        unsigned int q = (workerIndex >= 0 && owner == this) ? (unsigned int)workerIndex
+                                                             : nextQueue.fetch_add(1, std::memory_order_relaxed) % queues.size();
+        {
+            std::lock_guard<std::mutex> lock(queues[q]->m);
+            queues[q]->tasks.push_back({&group, std::move(task)});
+        }
+        wake.notify_one();
+    }
+
+    // Runs tasks (of any group) on the calling thread until every task submitted
+    // to `group` has finished, then rethrows the first exception one of them
+    // threw, if any.
+    void wait(TaskGroup &group) {
+        unsigned int self = (workerIndex >= 0 && owner == this) ? (unsigned int)workerIndex : 0;
+        while (group.pending.load(std::memory_order_acquire) > 0) {
+            if (!runOne(self)) std::this_thread::yield();
+        }
+        std::exception_ptr e;
+        {
+            std::lock_guard<std::mutex> lock(group.errorMutex);
+            e = std::exchange(group.error, nullptr);
+        }
+        if (e) std::rethrow_exception(e);
+    }
+
+    // Convenience: split [begin,end) into chunks of at most `grain` and run fn(chunkBegin, chunkEnd).
+    template <typename Fn>
+    void parallelFor(size_t begin, size_t end, size_t grain, Fn fn) {
+        if (grain == 0) grain = 1;
+        TaskGroup group;
+        for (size_t b = begin; b < end; b += grain) {
+            size_t e = std::min(end, b + grain);
+            submit(group, [fn, b, e] { fn(b, e); });
+        }
+        wait(group);
+    }
+
+private:
+    struct Task {
+        TaskGroup *group;
+        std::function<void()> run;
+    };
+
+    struct Queue {
+        std::mutex m;
+        std::deque<Task> tasks;
+    };
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> workers;
+    std::atomic<unsigned int> nextQueue{0};
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+    bool stopping = false;
+
+    inline static thread_local int workerIndex = -1;
+    inline static thread_local WorkStealingPool *owner = nullptr;
+
+    bool popLocal(unsigned int self, Task &task) {
+        std::lock_guard<std::mutex> lock(queues[self]->m);
+        if (queues[self]->tasks.empty()) return false;
+        task = std::move(queues[self]->tasks.back());
+        queues[self]->tasks.pop_back();
+        return true;
+    }
+
+    bool steal(unsigned int self, Task &task) {
+        for (size_t k = 1; k < queues.size(); k++) {
+            Queue &victim = *queues[(self + k) % queues.size()];
+            std::lock_guard<std::mutex> lock(victim.m);
+            if (victim.tasks.empty()) continue;
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            return true;
+        }
+        return false;
+    }
+
+    bool runOne(unsigned int self) {
+        Task task;
+        if (!popLocal(self, task) && !steal(self, task)) return false;
+        try {
+            task.run();
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(task.group->errorMutex);
+            if (!task.group->error) task.group->error = std::current_exception();
+        }
+        // last touch of the group: its waiter may return and destroy it right after
+        task.group->pending.fetch_sub(1, std::memory_order_release);
+        return true;
+    }
+
+    void workerLoop(unsigned int self) {
+        workerIndex = (int)self;
+        owner = this;
+        while (true) {
+            if (runOne(self)) continue;
+            std::unique_lock<std::mutex> lock(sleepMutex);
+            if (stopping) return;
+            // Short timed sleep: a missed notify only costs a millisecond, not a hang.
+            wake.wait_for(lock, std::chrono::milliseconds(1));
+            if (stopping) return;
+        }
+    }
+};
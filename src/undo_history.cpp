@@ -0,0 +1,195 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <unordered_set>
+#include <vector>
+
+#include "model.cpp"
+#include "parallel_update.cpp"
+
+// --- Undo / redo ---
+// Edits to a Model's tree are kept as deltas on its nodes. The state an edit
+// can change in place is a node's local transform, its shape's colour and its
+// static mark, a few dozen bytes, so a step stores just that for each node it touched, plus
+// the children it inserted or removed (kept alive, not copied). Shapes are
+// never copied, so no step duplicates or re-tessellates geometry, and memory
+// and undo/redo time grow with the nodes a step touched, not with the model,
+// however many steps are kept.
+//
+// A step holds the state its nodes had before it; undo swaps that with their
+// current state, which leaves the step holding the state redo needs, and redo
+// swaps it back.
+//
+// All edits to the tree must go through here: modify() before changing a node
+// in place, insert() and erase() to change the tree's structure.
+class EditHistory {
+public:
+    explicit EditHistory(Model &model, size_t maxSteps = 10000) : model(model), maxSteps(maxSteps) {}
+
+    // Groups every edit made during its lifetime into one step. Nested
+    // transactions join the outermost one; an edit made outside any
+    // transaction is a step of its own.
+    class Transaction {
+    public:
+        explicit Transaction(EditHistory &h) : h(h) { h.begin(); }
+        ~Transaction() { h.commit(); }
+        Transaction(const Transaction&) = delete;
+        Transaction& operator=(const Transaction&) = delete;
+    private:
+        EditHistory &h;
+    };
+
+    // Call before changing `node`'s transform, its shape's colour or its static mark.
+    void modify(HNode &node) {
+        Transaction t(*this);
+        if (!recorded(&node)) open.states.push_back({node.shared_from_this(), stateOf(node)});
+    }
+
+    // modify() for every node in `nodes` (no repeats), with their state read
+    // in parallel. Afterwards each node can be changed from any thread, one
+    // thread per node.
+    void modifyAll(const std::vector<HNode*> &nodes, WorkStealingPool *pool = &sharedPool()) {
+        Transaction t(*this);
+        std::vector<HNode*> added;
+        const std::vector<HNode*> *fresh = &nodes;
+        if (!open.states.empty()) {   // some nodes may already be in this step
+            for (HNode *n : nodes) if (!recorded(n)) added.push_back(n);
+            fresh = &added;
+        }
+        size_t first = open.states.size();
+        open.states.resize(first + fresh->size());
+        auto read = [&](size_t begin, size_t end) {
+            for (size_t k = begin; k < end; k++) {
+                HNode *n = (*fresh)[k];
+                open.states[first + k] = {n->shared_from_this(), stateOf(*n)};
+            }
+        };
+        if (pool && fresh->size() > 4096) pool->parallelFor(0, fresh->size(), 4096, read);
+        else read(0, fresh->size());
+    }
+
+    // Inserts `child` as child `index` of `parent`.
+    void insert(HNode &parent, size_t index, std::shared_ptr<HNode> child) {
+        Transaction t(*this);
+        open.edits.push_back({Edit::INSERT, parent.shared_from_this(), index, child});
+        parent.insertChild(index, std::move(child));
+        model.invalidateHierarchy();
+    }
+
+    // Removes child `index` of `parent`; the history keeps its subtree.
+    void erase(HNode &parent, size_t index) {
+        Transaction t(*this);
+        open.edits.push_back({Edit::ERASE, parent.shared_from_this(), index, parent.removeChild(index)});
+        model.invalidateHierarchy();
+    }
+
+    bool undo() {
+        if (undoSteps.empty() || depth) return false;
+        Step &step = undoSteps.back();
+        for (size_t k = step.edits.size(); k-- > 0;) {
+            const Edit &e = step.edits[k];
+            if (e.kind == Edit::INSERT) e.parent->removeChild(e.index);
+            else e.parent->insertChild(e.index, e.child);
+        }
+        swapStates(step);
+        redoSteps.push_back(std::move(step));
+        undoSteps.pop_back();
+        return true;
+    }
+
+    bool redo() {
+        if (redoSteps.empty() || depth) return false;
+        Step &step = redoSteps.back();
+        for (const Edit &e : step.edits) {
+            if (e.kind == Edit::INSERT) e.parent->insertChild(e.index, e.child);
+            else e.parent->removeChild(e.index);
+        }
+        swapStates(step);
+        undoSteps.push_back(std::move(step));
+        redoSteps.pop_back();
+        return true;
+    }
+
+    // Forgets every step, e.g. after loading a different model.
+    void clear() { undoSteps.clear(); redoSteps.clear(); }
+
+    size_t undoCount() const { return undoSteps.size(); }
+    size_t redoCount() const { return redoSteps.size(); }
+
+private:
+    struct NodeState {
+        glm::vec3 translation, rotation, scale;
+        glm::vec3 color;                       // of the node's shape, if it has one
+        bool isStatic;
+    };
+    struct StateChange {
+        std::shared_ptr<HNode> node;
+        NodeState state;                       // before the step while it can be undone, after it once undone
+    };
+    struct Edit {
+        enum Kind { INSERT, ERASE } kind;
+        std::shared_ptr<HNode> parent;
+        size_t index;
+        std::shared_ptr<HNode> child;
+    };
+    struct Step {
+        std::vector<StateChange> states;       // one per node
+        std::vector<Edit> edits;               // in the order they were made
+    };
+
+    Model &model;
+    size_t maxSteps;
+    std::deque<Step> undoSteps;
+    std::deque<Step> redoSteps;
+    Step open;
+    std::unordered_set<const HNode*> touched;  // nodes of open.states[0, indexed)
+    size_t indexed = 0;
+    int depth = 0;
+
+    static NodeState stateOf(const HNode &n) {
+        const std::shared_ptr<Shape> &s = n.getShape();
+        return {n.getTranslation(), n.getRotation(), n.getScale(), s ? s->getColor() : glm::vec3(0.0f), n.isStatic()};
+    }
+
+    // Whether the open step already holds `n`'s state. The set is filled
+    // lazily, so a step made by a single modifyAll() never hashes its nodes.
+    bool recorded(const HNode *n) {
+        for (; indexed < open.states.size(); indexed++) touched.insert(open.states[indexed].node.get());
+        return touched.count(n) != 0;
+    }
+
+    void swapStates(Step &step) {
+        auto swap = [&step](size_t begin, size_t end) {
+            for (size_t k = begin; k < end; k++) {
+                StateChange &c = step.states[k];
+                NodeState current = stateOf(*c.node);
+                c.node->setTransform(c.state.translation, c.state.rotation, c.state.scale, false);
+                if (const std::shared_ptr<Shape> &s = c.node->getShape()) s->setColor(c.state.color);
+                c.node->setStatic(c.state.isStatic);
+                c.state = current;
+            }
+        };
+        if (step.states.size() > 4096) sharedPool().parallelFor(0, step.states.size(), 4096, swap);
+        else swap(0, step.states.size());
+        if (!step.states.empty()) HNode::transformsChanged();
+        if (!step.edits.empty()) model.invalidateHierarchy();
+    }
+
+    void begin() {
+        if (depth++ == 0) open = Step();
+    }
+
+    void commit() {
+        if (--depth > 0) return;
+        touched.clear();
+        indexed = 0;
+        if (open.states.empty() && open.edits.empty()) return;
+        redoSteps.clear();
+        undoSteps.push_back(std::move(open));
+        if (undoSteps.size() > maxSteps) undoSteps.pop_front();
+    }
+};
@@ -0,0 +1,225 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <future>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <utility>
+#include <vector>
+
+#include "tessellation_level.cpp"
+#include "vertex_cache.cpp"
+
+// Indexed unit mesh for one primitive at one tessellation level: the geometry
+// of every shape of that type and level, with shared vertices, so it can be
+// uploaded once and reused by every node that uses it. The shape classes keep
+// only their parameters.
+struct UnitMesh {
+    std::vector<glm::vec3> positions;
+    std::vector<unsigned int> indices;
+
+    size_t triangleCount() const { return indices.size() / 3; }
+};
+
+// --- Generators ---
+
+inline void buildUnitSphere(UnitMesh &m, unsigned int level) {
+    int latDiv = 8 << (level - 1);   // 8,16,32,64,...
+    int longDiv = 16 << (level - 1); // 16,32,64,128,...
+    for (int i = 0; i <= latDiv; i++) {
+        float theta = M_PI * float(i) / latDiv;
+        for (int j = 0; j <= longDiv; j++) {
+            float phi = 2 * M_PI * float(j) / longDiv;
+            m.positions.push_back(glm::vec3(std::sin(theta)*std::cos(phi), std::cos(theta), std::sin(theta)*std::sin(phi)));
+        }
+    }
+    for (int i = 0; i < latDiv; i++) {
+        for (int j = 0; j < longDiv; j++) {
+            unsigned int v1 = i*(longDiv+1) + j, v2 = v1 + longDiv + 1, v3 = v1 + 1, v4 = v2 + 1;
+            m.indices.insert(m.indices.end(), {v1, v3, v2, v3, v4, v2});
+        }
+    }
+}
+
+inline void buildUnitBox(UnitMesh &m, unsigned int level) {
+    int divisions = 1 << (level - 1); // 1,2,4,8,... quads per face edge
+    // origin corner, u and v edge of each face, all faces wound outwards
+    const glm::vec3 faces[6][3] = {
+        {{ 0.5f,-0.5f,-0.5f}, {0,1,0}, {0,0,1}}, {{-0.5f,-0.5f,-0.5f}, {0,0,1}, {0,1,0}},
+        {{-0.5f, 0.5f,-0.5f}, {0,0,1}, {1,0,0}}, {{-0.5f,-0.5f,-0.5f}, {1,0,0}, {0,0,1}},
+        {{-0.5f,-0.5f, 0.5f}, {1,0,0}, {0,1,0}}, {{-0.5f,-0.5f,-0.5f}, {0,1,0}, {1,0,0}},
+    };
+    for (auto &f : faces) {
+        unsigned int base = m.positions.size();
+        for (int i = 0; i <= divisions; i++)
+            for (int j = 0; j <= divisions; j++)
+                m.positions.push_back(f[0] + f[1]*(float(i)/divisions) + f[2]*(float(j)/divisions));
+        for (int i = 0; i < divisions; i++) {
+            for (int j = 0; j < divisions; j++) {
+                unsigned int p0 = base + i*(divisions+1) + j, p1 = p0 + divisions + 1, p2 = p1 + 1, p3 = p0 + 1;
+                m.indices.insert(m.indices.end(), {p0, p1, p2, p0, p2, p3});
+            }
+        }
+    }
+}
+
+// Ring of `div` unit-radius vertices at height y; returns the first index.
+inline unsigned int addRing(UnitMesh &m, unsigned int div, float y) {
+    unsigned int base = m.positions.size();
+    for (unsigned int i = 0; i < div; i++) {
+        float theta = 2.0f * M_PI * i / div;
+        m.positions.push_back(glm::vec3(std::cos(theta), y, std::sin(theta)));
+    }
+    return base;
+}
+
+// Closes a ring with a triangle fan around `centre`.
+inline void addFan(UnitMesh &m, unsigned int ring, unsigned int div, const glm::vec3 &centre, bool flip) {
+    unsigned int c = m.positions.size();
+    m.positions.push_back(centre);
+    for (unsigned int i = 0; i < div; i++) {
+        unsigned int a = ring + i, b = ring + (i+1) % div;
+        if (flip) m.indices.insert(m.indices.end(), {c, b, a});
+        else      m.indices.insert(m.indices.end(), {c, a, b});
+    }
+}
+
+inline void buildUnitCylinder(UnitMesh &m, unsigned int level) {
+    unsigned int div = 16 << (level - 1); // 16,32,64,128,...
+    unsigned int bottom = addRing(m, div, -0.5f);
+    unsigned int top = addRing(m, div, 0.5f);
+    addFan(m, bottom, div, glm::vec3(0.0f,-0.5f,0.0f), false);
+    addFan(m, top, div, glm::vec3(0.0f,0.5f,0.0f), true);
+    for (unsigned int i = 0; i < div; i++) {
+        unsigned int v1 = bottom + i, v2 = bottom + (i+1) % div, v3 = top + i, v4 = top + (i+1) % div;
+        m.indices.insert(m.indices.end(), {v1, v3, v2, v2, v3, v4});
+    }
+}
+
+inline void buildUnitCone(UnitMesh &m, unsigned int level) {
+    unsigned int div = 16 << (level - 1);
+    unsigned int ring = addRing(m, div, 0.0f);
+    addFan(m, ring, div, glm::vec3(0.0f), false);
+    unsigned int apex = m.positions.size();
+    m.positions.push_back(glm::vec3(0.0f, 1.0f, 0.0f));
+    for (unsigned int i = 0; i < div; i++)
+        m.indices.insert(m.indices.end(), {ring + i, apex, ring + (i+1) % div});
+}
+
+// Meshes are vertex-cache optimised unless `optimize` is false (used for reporting).
+inline UnitMesh buildUnitMesh(ShapeType type, unsigned int level, bool optimize = true) {
+    UnitMesh m;
+    level = clampLevel(level);
+    switch (type) {
+        case ShapeType::SPHERE_SHAPE:   buildUnitSphere(m, level); break;
+        case ShapeType::BOX_SHAPE:      buildUnitBox(m, level); break;
+        case ShapeType::CYLINDER_SHAPE: buildUnitCylinder(m, level); break;
+        case ShapeType::CONE_SHAPE:     buildUnitCone(m, level); break;
+    }
+    if (optimize) vcache::optimize(m.positions, m.indices);
+    return m;
+}
+
+// Triangle count of buildUnitMesh(type, level), without building it.
+inline size_t unitTriangleCount(ShapeType type, unsigned int level) {
+    size_t d = (size_t)1 << (clampLevel(level) - 1);
+    switch (type) {
+        case ShapeType::SPHERE_SHAPE:   return 8 * d * 16 * d * 2;
+        case ShapeType::BOX_SHAPE:      return 6 * d * d * 2;
+        case ShapeType::CYLINDER_SHAPE: return 16 * d * 4;   // two caps, two triangles per side quad
+        case ShapeType::CONE_SHAPE:     return 16 * d * 2;
+    }
+    return 0;
+}
+
+// Shared, lazily built meshes. Each one is built once, on its own thread, the
+// first time anything asks for it; entries are never freed, so references stay
+// valid. get() waits for the build, ready() never does.
+class UnitMeshCache {
+public:
+    // Blocks until (type, level) is built.
+    const UnitMesh& get(ShapeType type, unsigned int level) { return *slot(type, level, true).get(); }
+
+    // The mesh if it is built, else nullptr. With `request`, a build that has
+    // not been started yet is started in the background.
+    const UnitMesh* ready(ShapeType type, unsigned int level, bool request = true) {
+        Build b = slot(type, level, request);
+        if (!b.valid() || b.wait_for(std::chrono::seconds(0)) != std::future_status::ready) return nullptr;
+        return b.get().get();
+    }
+
+private:
+    using Build = std::shared_future<std::shared_ptr<const UnitMesh>>;
+    std::mutex mutex;
+    std::map<std::pair<int, unsigned int>, Build> builds;
+
+    // Returns a copy: a shared_future must not be shared between threads by reference.
+    Build slot(ShapeType type, unsigned int level, bool start) {
+        level = clampLevel(level);
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = builds.find({(int)type, level});
+        if (it != builds.end()) return it->second;
+        if (!start) return Build();
+        Build b = std::async(std::launch::async, [type, level] {
+            return std::make_shared<const UnitMesh>(buildUnitMesh(type, level));
+        }).share();
+        builds[{(int)type, level}] = b;
+        return b;
+    }
+};
+
+inline UnitMeshCache& unitMeshCache() {
+    static UnitMeshCache cache;
+    return cache;
+}
+
+// Blocking lookup, for callers that need the exact mesh (export, baking, reports).
+inline const UnitMesh& unitMesh(ShapeType type, unsigned int level) {
+    return unitMeshCache().get(type, level);
+}
+
+// Volume enclosed by the mesh, positive when every triangle is wound
+// counter-clockwise seen from outside.
+inline double signedVolume(const UnitMesh &m) {
+    double v = 0.0;
+    for (size_t i = 0; i + 2 < m.indices.size(); i += 3) {
+        const glm::vec3 &a = m.positions[m.indices[i]], &b = m.positions[m.indices[i+1]], &c = m.positions[m.indices[i+2]];
+        v += glm::dot(a, glm::cross(b, c));
+    }
+    return v / 6.0;
+}
+
+// ACMR of every primitive and level as generated row by row and after the
+// vertex cache pass, for FIFO caches of 16 and 32 entries, with each mesh's
+// signed volume. Returns false if any mesh is wound inwards.
+inline bool printVertexCacheReport(std::ostream &out) {
+    bool outward = true;
+    const ShapeType types[] = {ShapeType::SPHERE_SHAPE, ShapeType::CYLINDER_SHAPE, ShapeType::BOX_SHAPE, ShapeType::CONE_SHAPE};
+    const char *names[] = {"SPHERE", "CYLINDER", "BOX", "CONE"};
+    out << "shape     level tris   verts  acmr16_raw acmr16_opt acmr32_raw acmr32_opt volume\n";
+    for (int t = 0; t < 4; t++) {
+        for (unsigned int level = 1; level <= 4; level++) {
+            UnitMesh raw = buildUnitMesh(types[t], level, false);
+            UnitMesh opt = buildUnitMesh(types[t], level);
+            out << std::left << std::setw(10) << names[t] << std::setw(6) << level
+                << std::setw(7) << raw.triangleCount() << std::setw(7) << raw.positions.size()
+                << std::fixed << std::setprecision(3)
+                << std::setw(11) << vcache::acmr(raw.indices, raw.positions.size(), 16)
+                << std::setw(11) << vcache::acmr(opt.indices, opt.positions.size(), 16)
+                << std::setw(11) << vcache::acmr(raw.indices, raw.positions.size(), 32)
+                << std::setw(11) << vcache::acmr(opt.indices, opt.positions.size(), 32)
+                << signedVolume(opt) << "\n";
+            if (signedVolume(opt) <= 0.0) {
+                out << names[t] << " level " << level << " is wound inwards\n";
+                outward = false;
+            }
+        }
+    }
+    return outward;
+}
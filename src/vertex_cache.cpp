@@ -0,0 +1,143 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cmath>
+#include <utility>
+#include <vector>
+
+// Post-transform vertex cache optimisation for indexed triangle lists.
+// Triangles are reordered with Tom Forsyth's linear-speed greedy algorithm,
+// then vertices are renumbered in first-use order so fetches walk the vertex
+// buffer front to back.
+namespace vcache {
+
+const int kCacheSize = 32;
+
+inline float vertexScore(int cachePos, int remainingTris) {
+    if (remainingTris == 0) return -1.0f;
+    float score = 0.0f;
+    if (cachePos >= 0) {
+        if (cachePos < 3) score = 0.75f; // vertices of the last triangle: don't favour them too much
+        else score = std::pow(1.0f - float(cachePos - 3) / (kCacheSize - 3), 1.5f);
+    }
+    return score + 2.0f * std::pow((float)remainingTris, -0.5f); // boost vertices with few triangles left
+}
+
+// Average cache miss ratio (vertex shader runs per triangle) for a FIFO cache.
+inline float acmr(const std::vector<unsigned int> &indices, size_t vertexCount, int cacheSize) {
+    if (indices.empty()) return 0.0f;
+    std::vector<long> stamp(vertexCount, -(long)cacheSize - 1);
+    long time = 0, misses = 0;
+    for (unsigned int v : indices) {
+        if (time - stamp[v] > cacheSize) { misses++; stamp[v] = time++; }
+    }
+    return float(misses) / (indices.size() / 3);
+}
+
+inline std::vector<unsigned int> optimizeTriangleOrder(const std::vector<unsigned int> &indices, size_t vertexCount) {
+    size_t triCount = indices.size() / 3;
+    std::vector<unsigned int> out;
+    out.reserve(indices.size());
+
+    // vertex -> live triangles, packed in one array
+    std::vector<int> remaining(vertexCount, 0), offset(vertexCount + 1, 0);
+    for (unsigned int v : indices) remaining[v]++;
+    for (size_t v = 0; v < vertexCount; v++) offset[v+1] = offset[v] + remaining[v];
+    std::vector<int> adjacency(indices.size());
+    std::vector<int> fill(offset.begin(), offset.end() - 1);
+    for (size_t t = 0; t < triCount; t++)
+        for (int k = 0; k < 3; k++) adjacency[fill[indices[3*t+k]]++] = (int)t;
+
+    std::vector<int> cachePos(vertexCount, -1);
+    std::vector<float> vScore(vertexCount), tScore(triCount);
+    std::vector<bool> emitted(triCount, false);
+    for (size_t v = 0; v < vertexCount; v++) vScore[v] = vertexScore(-1, remaining[v]);
+    auto scoreTri = [&](int t) { return vScore[indices[3*t]] + vScore[indices[3*t+1]] + vScore[indices[3*t+2]]; };
+    for (size_t t = 0; t < triCount; t++) tScore[t] = scoreTri((int)t);
+
+    // (score, triangle) pushed whenever a triangle is scored, so the best
+    // remaining triangle is found without a scan; entries of emitted triangles
+    // or with an old score are skipped, and the heap is rebuilt from the live
+    // triangles before they outnumber those several times over.
+    using Entry = std::pair<float, int>;
+    auto worse = [](const Entry &a, const Entry &b) { return a.first < b.first || (a.first == b.first && a.second > b.second); };
+    std::vector<Entry> heap;
+    auto rebuild = [&] {
+        heap.clear();
+        for (size_t t = 0; t < triCount; t++) if (!emitted[t]) heap.push_back({tScore[t], (int)t});
+        std::make_heap(heap.begin(), heap.end(), worse);
+    };
+    rebuild();
+
+    std::vector<int> cache, next;
+    int best = -1;
+    for (size_t n = 0; n < triCount; n++) {
+        // nothing adjacent to the cache is left: take the best remaining triangle
+        while (best < 0) {
+            std::pop_heap(heap.begin(), heap.end(), worse);
+            Entry e = heap.back();
+            heap.pop_back();
+            if (!emitted[e.second] && e.first == tScore[e.second]) best = e.second;
+        }
+
+        emitted[best] = true;
+        const unsigned int *tri = &indices[3*best];
+        for (int k = 0; k < 3; k++) {
+            unsigned int v = tri[k];
+            out.push_back(v);
+            int *live = &adjacency[offset[v]];
+            for (int i = 0; i < remaining[v]; i++)
+                if (live[i] == best) { live[i] = live[remaining[v] - 1]; break; }
+            remaining[v]--;
+        }
+
+        // LRU update: the triangle's vertices move to the front
+        next.assign(tri, tri + 3);
+        for (int v : cache)
+            if (v != (int)tri[0] && v != (int)tri[1] && v != (int)tri[2]) next.push_back(v);
+        for (size_t i = 0; i < next.size(); i++) {
+            int v = next[i];
+            cachePos[v] = i < (size_t)kCacheSize ? (int)i : -1;
+            vScore[v] = vertexScore(cachePos[v], remaining[v]);
+        }
+
+        // rescore triangles around every touched vertex; the best one near the cache goes next
+        best = -1;
+        float bestScore = -1e30f;
+        for (size_t i = 0; i < next.size(); i++) {
+            int v = next[i];
+            for (int j = 0; j < remaining[v]; j++) {
+                int t = adjacency[offset[v] + j];
+                tScore[t] = scoreTri(t);
+                heap.push_back({tScore[t], t});
+                std::push_heap(heap.begin(), heap.end(), worse);
+                if (i < (size_t)kCacheSize && tScore[t] > bestScore) { bestScore = tScore[t]; best = t; }
+            }
+        }
+        if (next.size() > (size_t)kCacheSize) next.resize(kCacheSize);
+        std::swap(cache, next);
+        if (heap.size() > 4 * triCount + 64) rebuild();
+    }
+    return out;
+}
+
+// Renumbers vertices in the order the index buffer first uses them.
+// Vertices no triangle references are dropped.
+inline void reorderVertices(std::vector<glm::vec3> &positions, std::vector<unsigned int> &indices) {
+    std::vector<int> remap(positions.size(), -1);
+    std::vector<glm::vec3> reordered;
+    reordered.reserve(positions.size());
+    for (auto &idx : indices) {
+        if (remap[idx] < 0) { remap[idx] = (int)reordered.size(); reordered.push_back(positions[idx]); }
+        idx = remap[idx];
+    }
+    positions.swap(reordered);
+}
+
+inline void optimize(std::vector<glm::vec3> &positions, std::vector<unsigned int> &indices) {
+    indices = optimizeTriangleOrder(indices, positions.size());
+    reorderVertices(positions, indices);
+}
+
+} // namespace vcache
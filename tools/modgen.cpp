@@ -0,0 +1,102 @@
+// Synthetic .mod generator for load-time and frame-time scaling tests.
+//
+//   modgen --nodes 1000000 --depth 10 --branching 8 --mix sphere=2,box=1
+//          --levels 1-3 --seed 42 [--compact] -o big.mod
+//
+// The same options always produce the same file.
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <type_traits>
+
+#include "../src/model_generator.cpp"
+
+static void usage(const char *argv0) {
+    std::cerr << "Usage: " << argv0 << " [--nodes N] [--depth D] [--branching B] [--mix type=weight,...]\n"
+              << "       [--levels MIN-MAX] [--seed S] [--compact] -o FILE\n"
+              << "Types for --mix: sphere, cylinder, box, cone (unlisted types get weight 0).\n";
+}
+
+// A whole decimal number in [lo, hi], nothing else (no sign, no trailing text).
+static bool parseNumber(const char *text, unsigned long long lo, unsigned long long hi, unsigned long long &value) {
+    if (*text < '0' || *text > '9') return false;
+    char *end = nullptr;
+    errno = 0;
+    value = std::strtoull(text, &end, 10);
+    return errno == 0 && *end == '\0' && value >= lo && value <= hi;
+}
+
+static bool parseMix(const std::string &spec, double mix[4]) {
+    for (int i = 0; i < 4; i++) mix[i] = 0.0;
+    std::istringstream ss(spec);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        size_t eq = item.find('=');
+        std::string name = item.substr(0, eq);
+        double weight = 1.0;
+        char *end = nullptr;
+        if (eq != std::string::npos) weight = std::strtod(item.c_str() + eq + 1, &end);
+        bool badWeight = eq != std::string::npos && (end == item.c_str() + eq + 1 || *end != '\0' || !(weight >= 0));
+        int t = name == "sphere" ? 0 : name == "cylinder" ? 1 : name == "box" ? 2 : name == "cone" ? 3 : -1;
+        if (t < 0 || badWeight) { std::cerr << "Invalid mix entry '" << item << "'\n"; return false; }
+        mix[t] = weight;
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+    GeneratorOptions opt;
+    std::string outPath;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        bool ok = true;
+        // Stores the next argument in `field` if it is a number in [lo, hi].
+        auto number = [&](unsigned long long lo, unsigned long long hi, auto &field) {
+            unsigned long long n;
+            if (!parseNumber(argv[++i], lo, hi, n)) {
+                std::cerr << "Invalid " << arg << " '" << argv[i] << "', expected " << lo << "-" << hi << "\n";
+                return false;
+            }
+            field = (std::remove_reference_t<decltype(field)>)n;
+            return true;
+        };
+        if (arg == "--nodes" && hasValue) ok = number(1, UINT64_MAX, opt.nodes);
+        else if (arg == "--depth" && hasValue) ok = number(1, 1u << 20, opt.depth);
+        else if (arg == "--branching" && hasValue) ok = number(1, 1u << 20, opt.branching);
+        else if (arg == "--seed" && hasValue) ok = number(0, UINT64_MAX, opt.seed);
+        else if (arg == "--mix" && hasValue) ok = parseMix(argv[++i], opt.mix);
+        else if (arg == "--levels" && hasValue) {
+            std::string v = argv[++i];
+            size_t dash = v.find('-');
+            unsigned long long lo = 0, hi = 0;
+            ok = parseNumber(v.substr(0, dash).c_str(), 1, kMaxTessellationLevel, lo);
+            if (ok && dash == std::string::npos) hi = lo;
+            else ok = ok && parseNumber(v.c_str() + dash + 1, lo, kMaxTessellationLevel, hi);
+            if (!ok) std::cerr << "Invalid --levels '" << v << "', expected MIN-MAX within 1-" << kMaxTessellationLevel << "\n";
+            opt.minLevel = (unsigned int)lo;
+            opt.maxLevel = (unsigned int)hi;
+        }
+        else if (arg == "--compact") opt.indent = false;
+        else if (arg == "-o" && hasValue) outPath = argv[++i];
+        else ok = false;
+        if (!ok) { usage(argv[0]); return 2; }
+    }
+    if (outPath.empty()) { usage(argv[0]); return 2; }
+
+    std::ofstream out(outPath, std::ios::binary);
+    if (!out) { std::cerr << "Cannot open " << outPath << " to write\n"; return 1; }
+    ModelGenerator generator;
+    std::string error;
+    if (!generator.generate(opt, out, error)) {
+        std::cerr << "modgen: " << error << "\n";
+        return 1;
+    }
+    std::cout << "Wrote " << opt.nodes << " nodes to " << outPath << "\n";
+    return 0;
+}